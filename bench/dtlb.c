@@ -0,0 +1,180 @@
+/*
+ * dtlb.c - data TLB misses per operation of one allocator variant.
+ *
+ * Builds a large fragmented heap (many live blocks of mixed sizes, every
+ * other one freed), then replays random malloc/free pairs against it
+ * while the hardware counts data TLB load and store misses through
+ * perf_event_open. Prints the misses per operation, the heap size and how
+ * much of the process is backed by transparent huge pages.
+ *
+ * Build it with and without the huge page mode of the segregated free
+ * list, next to the handout's mm.h and contracts.h, e.g.
+ *
+ *   gcc -O2 -pthread -DDRIVER -DNDEBUG -Imemlib -I<handout> -o dtlb-4k \
+ *       bench/dtlb.c "src/segregated free list/mm.c" memlib/memlib.c
+ *   gcc -O2 -pthread -DDRIVER -DNDEBUG -DHUGE_PAGES -Imemlib -I<handout> \
+ *       -o dtlb-thp bench/dtlb.c "src/segregated free list/mm.c" memlib/memlib.c
+ *
+ * and run both with the same arguments:
+ *
+ *   ./dtlb-thp [ops] [live blocks]
+ *
+ * The counters need perf_event_paranoid <= 2 (or CAP_PERFMON); without
+ * them the run still reports the time per operation.
+ */
+
+#define _GNU_SOURCE // syscall
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define DEFAULT_OPS 2000000
+#define DEFAULT_LIVE 1000000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+// 60% up to 128 bytes, 35% up to 2KB, 5% up to 16KB
+static size_t random_size(void) {
+  unsigned int r = rng() % 100;
+  if(r < 60)
+    return 1 + rng() % 128;
+  if(r < 95)
+    return 1 + rng() % 2048;
+  return 1 + rng() % 16384;
+}
+
+static inline double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Open a counter of data TLB misses for op, -1 if there is none
+static int dtlb_counter(int op) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (op << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long counter_read(int fd) {
+  long long count;
+  if(fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+    return -1;
+  return count;
+}
+
+// Return the AnonHugePages of the process in kB, -1 if unknown
+static long anon_huge_kb(void) {
+  FILE *f = fopen("/proc/self/smaps_rollup", "r");
+  char line[256];
+  long kb = -1;
+
+  if(f == NULL)
+    return -1;
+  while(fgets(line, sizeof(line), f) != NULL){
+    if(sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+      break;
+  }
+  fclose(f);
+  return kb;
+}
+
+int main(int argc, char **argv) {
+  long ops = argc > 1 ? atol(argv[1]) : DEFAULT_OPS;
+  long live = argc > 2 ? atol(argv[2]) : DEFAULT_LIVE;
+  void **slots = calloc(live, sizeof(void *));
+  int loads, stores;
+  long long load_misses, store_misses;
+  double start, elapsed;
+
+  if(slots == NULL || ops < 1 || live < 2){
+    fprintf(stderr, "usage: %s [ops] [live blocks >= 2]\n", argv[0]);
+    return 1;
+  }
+
+  mem_init();
+  if(mm_init() < 0){
+    fprintf(stderr, "dtlb: mm_init failed\n");
+    return 1;
+  }
+
+  // a large heap with a hole after every other block
+  for(long i = 0; i < live; i++){
+    if((slots[i] = mm_malloc(random_size())) == NULL){
+      fprintf(stderr, "dtlb: mm_malloc failed\n");
+      return 1;
+    }
+  }
+  for(long i = 0; i < live; i += 2){
+    mm_free(slots[i]);
+    slots[i] = NULL;
+  }
+
+  loads = dtlb_counter(PERF_COUNT_HW_CACHE_OP_READ);
+  stores = dtlb_counter(PERF_COUNT_HW_CACHE_OP_WRITE);
+  if(loads >= 0)
+    ioctl(loads, PERF_EVENT_IOC_ENABLE, 0);
+  if(stores >= 0)
+    ioctl(stores, PERF_EVENT_IOC_ENABLE, 0);
+
+  start = now_s();
+  for(long i = 0; i < ops; i++){
+    long slot = rng() % live;
+
+    if(slots[slot] == NULL){
+      if((slots[slot] = mm_malloc(random_size())) == NULL){
+        fprintf(stderr, "dtlb: mm_malloc failed\n");
+        return 1;
+      }
+      *(char *) slots[slot] = 1; // touch it like a real caller would
+    }else{
+      mm_free(slots[slot]);
+      slots[slot] = NULL;
+    }
+  }
+  elapsed = now_s() - start;
+
+  if(loads >= 0)
+    ioctl(loads, PERF_EVENT_IOC_DISABLE, 0);
+  if(stores >= 0)
+    ioctl(stores, PERF_EVENT_IOC_DISABLE, 0);
+  load_misses = counter_read(loads);
+  store_misses = counter_read(stores);
+
+  printf("heap %zu bytes  AnonHugePages %ld kB  %.1f ns/op\n",
+         mem_heapsize(), anon_huge_kb(), elapsed / ops * 1e9);
+  if(load_misses < 0 && store_misses < 0){
+    printf("dTLB counters unavailable\n");
+    return 0;
+  }
+  if(load_misses >= 0)
+    printf("dTLB load misses  %lld  %.3f per op\n", load_misses, (double) load_misses / ops);
+  if(store_misses >= 0)
+    printf("dTLB store misses %lld  %.3f per op\n", store_misses, (double) store_misses / ops);
+  return 0;
+}
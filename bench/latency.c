@@ -0,0 +1,124 @@
+/*
+ * latency.c - per-operation latency of one allocator variant.
+ *
+ * Replays a fragmenting random workload (mostly small blocks, some pages,
+ * a few 64KB buffers) against mm_malloc/mm_free and times every single
+ * call. Prints the p50, p99, p99.9 and max latency in nanoseconds for
+ * malloc and free separately.
+ *
+ * Build it once per variant, next to the handout's memlib.c, mm.h and
+ * contracts.h, e.g.
+ *
+ *   gcc -O2 -DDRIVER -DNDEBUG -I<handout> -o latency-tlsf bench/latency.c \
+ *       "src/two-level segregated fit/mm.c" <handout>/memlib.c
+ *   gcc -O2 -DDRIVER -DNDEBUG -I<handout> -o latency-bestfit bench/latency.c \
+ *       "src/explicit free list with best fit/mm.c" <handout>/memlib.c
+ *
+ * and run both with the same arguments:
+ *
+ *   ./latency-tlsf [ops] [live blocks] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define DEFAULT_OPS 1000000
+#define DEFAULT_LIVE 20000
+
+static uint64_t rng_state;
+
+static uint64_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+// 70% up to 64 bytes, 25% up to 1KB, 4% up to 8KB, 1% up to 64KB
+static size_t random_size(void) {
+  unsigned int r = rng() % 100;
+  if(r < 70)
+    return 1 + rng() % 64;
+  if(r < 95)
+    return 1 + rng() % 1024;
+  if(r < 99)
+    return 1 + rng() % 8192;
+  return 1 + rng() % 65536;
+}
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return (x > y) - (x < y);
+}
+
+static void report(const char *op, uint32_t *samples, long n) {
+  if(n == 0)
+    return;
+  qsort(samples, n, sizeof(uint32_t), cmp_u32);
+  printf("%-6s %9ld ops  p50 %6u ns  p99 %6u ns  p99.9 %7u ns  max %8u ns\n",
+         op, n, samples[n / 2], samples[n * 99 / 100],
+         samples[n * 999 / 1000], samples[n - 1]);
+}
+
+int main(int argc, char **argv) {
+  long ops = argc > 1 ? atol(argv[1]) : DEFAULT_OPS;
+  long live = argc > 2 ? atol(argv[2]) : DEFAULT_LIVE;
+  rng_state = argc > 3 ? strtoull(argv[3], NULL, 0) : 0x9E3779B97F4A7C15ULL;
+
+  void **slots = calloc(live, sizeof(void *));
+  uint32_t *malloc_ns = malloc(ops * sizeof(uint32_t));
+  uint32_t *free_ns = malloc(ops * sizeof(uint32_t));
+  long n_malloc = 0, n_free = 0;
+
+  if(slots == NULL || malloc_ns == NULL || free_ns == NULL){
+    fprintf(stderr, "latency: out of memory for samples\n");
+    return 1;
+  }
+
+  mem_init();
+  if(mm_init() < 0){
+    fprintf(stderr, "latency: mm_init failed\n");
+    return 1;
+  }
+
+  for(long i = 0; i < ops; i++){
+    long slot = rng() % live;
+    uint64_t start, end;
+
+    if(slots[slot] == NULL){
+      size_t size = random_size();
+      start = now_ns();
+      slots[slot] = mm_malloc(size);
+      end = now_ns();
+      if(slots[slot] == NULL){
+        fprintf(stderr, "latency: mm_malloc(%zu) failed\n", size);
+        return 1;
+      }
+      *(char *) slots[slot] = 1; // touch it like a real caller would
+      malloc_ns[n_malloc++] = end - start;
+    }else{
+      start = now_ns();
+      mm_free(slots[slot]);
+      end = now_ns();
+      slots[slot] = NULL;
+      free_ns[n_free++] = end - start;
+    }
+  }
+
+  printf("heap %zu bytes\n", mem_heapsize());
+  report("malloc", malloc_ns, n_malloc);
+  report("free", free_ns, n_free);
+  return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * replay.c - replay malloc lab trace files against one allocator variant
+ * and report throughput and utilization as JSON.
+ *
+ * A trace starts with four numbers: suggested heap size, number of block
+ * ids, number of operations and weight, followed by one operation per
+ * line:
+ *
+ *   a <id> <size>   allocate size bytes as block id
+ *   r <id> <size>   reallocate block id to size bytes
+ *   f <id>          free block id
+ *
+ * Every trace is first replayed once with checking: payloads must be
+ * 8-byte aligned, and each block is filled with a byte of its own that
+ * must still be there when it is reallocated or freed. That run measures
+ * peak utilization, the most payload ever live over the most memory ever
+ * held: mem_heapsize, plus the mappings of large blocks for a variant
+ * that reports them through the mm_stats of its mm_ext.h. The trace is then
+ * replayed reps more times without checking, each after a fresh mm_init,
+ * to measure operations per second.
+ *
+ * Build it once per variant, next to the handout's memlib.c, mm.h and
+ * contracts.h, with the variant's directory on the include path, e.g.
+ *
+ *   gcc -O2 -pthread -DDRIVER -DNDEBUG -I<handout> \
+ *       -I"src/two-level segregated fit" -o replay-tlsf \
+ *       bench/replay.c "src/two-level segregated fit/mm.c" <handout>/memlib.c
+ *
+ * and run it as
+ *
+ *   ./replay-tlsf [-n variant name] [-r reps] trace...
+ *
+ * It prints a JSON array with one object per trace; bench/replay.sh builds
+ * every variant under src/ and merges their arrays into one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#if __has_include("mm_ext.h")
+#include "mm_ext.h" // a variant with mappings outside its heap
+#pragma weak mm_stats // NULL unless the variant built in defines it
+#endif
+
+#define DEFAULT_REPS 10
+
+struct op {
+  char type; // 'a', 'r' or 'f'
+  int id;
+  size_t size;
+};
+
+struct trace {
+  const char *path;
+  int num_ids;
+  int num_ops;
+  struct op *ops;
+};
+
+struct result {
+  int ok;
+  const char *error;
+  double ops_per_sec;
+  double peak_util;
+  size_t heap_bytes; // after the checked run, see held_bytes
+  size_t peak_heap_bytes;
+};
+
+static inline double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read the trace at path into t; return -1 on error, 0 on success
+static int read_trace(const char *path, struct trace *t) {
+  FILE *f = fopen(path, "r");
+  int heap_size, weight, n = 0;
+  char type[2];
+
+  if(f == NULL){
+    perror(path);
+    return -1;
+  }
+  t->path = path;
+  if(fscanf(f, "%d %d %d %d", &heap_size, &t->num_ids, &t->num_ops, &weight) != 4 ||
+     t->num_ids < 0 || t->num_ops < 0){
+    fprintf(stderr, "replay: %s: bad header\n", path);
+    fclose(f);
+    return -1;
+  }
+  if((t->ops = calloc(t->num_ops + 1, sizeof(struct op))) == NULL){
+    fprintf(stderr, "replay: out of memory for %s\n", path);
+    fclose(f);
+    return -1;
+  }
+
+  while(n < t->num_ops && fscanf(f, "%1s", type) == 1){
+    struct op *op = &t->ops[n];
+    unsigned long size = 0;
+
+    op->type = type[0];
+    if(op->type == 'f'){
+      if(fscanf(f, "%d", &op->id) != 1)
+        break;
+    }else if(op->type == 'a' || op->type == 'r'){
+      if(fscanf(f, "%d %lu", &op->id, &size) != 2)
+        break;
+      op->size = size;
+    }else{
+      break;
+    }
+    if(op->id < 0 || op->id >= t->num_ids)
+      break;
+    n++;
+  }
+  fclose(f);
+  if(n != t->num_ops){
+    fprintf(stderr, "replay: %s: bad operation %d\n", path, n + 1);
+    free(t->ops);
+    return -1;
+  }
+  return 0;
+}
+
+// Return the memory the variant holds for blocks: its heap, and the
+// mappings of large blocks if it reports them
+static size_t held_bytes(void) {
+#ifdef MM_EXT_H
+  if(mm_stats != NULL){
+    struct mm_stats stats;
+
+    mm_stats(&stats);
+    return mem_heapsize() + stats.mapped_bytes;
+  }
+#endif
+  return mem_heapsize();
+}
+
+// Return whether the first n bytes at p all hold c
+static int filled(const unsigned char *p, size_t n, unsigned char c) {
+  for(size_t i = 0; i < n; i++){
+    if(p[i] != c)
+      return 0;
+  }
+  return 1;
+}
+
+// Replay t once with checking and fill in ok, peak_util and the heap sizes
+static void replay_checked(const struct trace *t, struct result *r) {
+  void **blocks = calloc(t->num_ids, sizeof(void *));
+  size_t *sizes = calloc(t->num_ids, sizeof(size_t));
+  size_t live = 0, peak_live = 0;
+
+  r->ok = 0;
+  if(blocks == NULL || sizes == NULL){
+    r->error = "out of memory for block table";
+    goto out;
+  }
+  mem_reset_brk();
+  if(mm_init() < 0){
+    r->error = "mm_init failed";
+    goto out;
+  }
+  r->peak_heap_bytes = held_bytes();
+
+  for(int i = 0; i < t->num_ops; i++){
+    const struct op *op = &t->ops[i];
+    unsigned char c = (unsigned char) op->id;
+    void *p;
+
+    if(op->type == 'f'){
+      if(blocks[op->id] != NULL && !filled(blocks[op->id], sizes[op->id], c)){
+        r->error = "payload changed before free";
+        goto out;
+      }
+      mm_free(blocks[op->id]);
+      live -= sizes[op->id];
+      blocks[op->id] = NULL;
+      sizes[op->id] = 0;
+      continue;
+    }
+
+    if(op->type == 'a'){
+      p = mm_malloc(op->size);
+    }else{
+      size_t keep = op->size < sizes[op->id] ? op->size : sizes[op->id];
+      if(blocks[op->id] != NULL && !filled(blocks[op->id], sizes[op->id], c)){
+        r->error = "payload changed before realloc";
+        goto out;
+      }
+      p = mm_realloc(blocks[op->id], op->size);
+      if(p != NULL && !filled(p, keep, c)){
+        r->error = "realloc lost the payload";
+        goto out;
+      }
+      live -= sizes[op->id];
+    }
+    if(p == NULL && op->size != 0){
+      r->error = "allocation failed";
+      goto out;
+    }
+    if(((uintptr_t) p & 7) != 0){
+      r->error = "payload not 8-byte aligned";
+      goto out;
+    }
+    if(p != NULL)
+      memset(p, c, op->size);
+    blocks[op->id] = p;
+    sizes[op->id] = p != NULL ? op->size : 0;
+    live += sizes[op->id];
+
+    if(live > peak_live)
+      peak_live = live;
+    if(held_bytes() > r->peak_heap_bytes)
+      r->peak_heap_bytes = held_bytes();
+  }
+
+  r->heap_bytes = held_bytes();
+  r->peak_util = r->peak_heap_bytes != 0 ? (double) peak_live / r->peak_heap_bytes : 0;
+  r->ok = 1;
+out:
+  free(blocks);
+  free(sizes);
+}
+
+// Replay t reps times without checking and fill in ops_per_sec
+static void replay_timed(const struct trace *t, int reps, struct result *r) {
+  void **blocks = calloc(t->num_ids, sizeof(void *));
+  double elapsed = 0;
+
+  if(blocks == NULL){
+    r->ok = 0;
+    r->error = "out of memory for block table";
+    return;
+  }
+  for(int rep = 0; rep < reps; rep++){
+    double start;
+
+    memset(blocks, 0, t->num_ids * sizeof(void *));
+    mem_reset_brk();
+    if(mm_init() < 0){
+      r->ok = 0;
+      r->error = "mm_init failed";
+      break;
+    }
+
+    start = now_s();
+    for(int i = 0; i < t->num_ops; i++){
+      const struct op *op = &t->ops[i];
+
+      if(op->type == 'a')
+        blocks[op->id] = mm_malloc(op->size);
+      else if(op->type == 'r')
+        blocks[op->id] = mm_realloc(blocks[op->id], op->size);
+      else
+        mm_free(blocks[op->id]);
+    }
+    elapsed += now_s() - start;
+  }
+  r->ops_per_sec = elapsed > 0 ? (double) t->num_ops * reps / elapsed : 0;
+  free(blocks);
+}
+
+// Print s as a JSON string
+static void print_json_string(const char *s) {
+  putchar('"');
+  for(; *s != '\0'; s++){
+    if(*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else if((unsigned char) *s < 0x20)
+      printf("\\u%04x", *s);
+    else
+      putchar(*s);
+  }
+  putchar('"');
+}
+
+static void print_result(const char *variant, const struct trace *t,
+                         const struct result *r) {
+  printf("{\"variant\": ");
+  print_json_string(variant);
+  printf(", \"trace\": ");
+  print_json_string(t->path);
+  printf(", \"ops\": %d, \"ok\": %s", t->num_ops, r->ok ? "true" : "false");
+  if(r->ok){
+    printf(", \"ops_per_sec\": %.0f, \"peak_util\": %.4f"
+           ", \"heap_bytes\": %zu, \"peak_heap_bytes\": %zu}",
+           r->ops_per_sec, r->peak_util, r->heap_bytes, r->peak_heap_bytes);
+  }else{
+    printf(", \"error\": ");
+    print_json_string(r->error);
+    putchar('}');
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *variant = "mm";
+  int reps = DEFAULT_REPS;
+  int opt, failed = 0, printed = 0;
+
+  while((opt = getopt(argc, argv, "n:r:")) != -1){
+    if(opt == 'n'){
+      variant = optarg;
+    }else if(opt == 'r' && atoi(optarg) > 0){
+      reps = atoi(optarg);
+    }else{
+      fprintf(stderr, "usage: %s [-n variant name] [-r reps] trace...\n", argv[0]);
+      return 1;
+    }
+  }
+  if(optind == argc){
+    fprintf(stderr, "usage: %s [-n variant name] [-r reps] trace...\n", argv[0]);
+    return 1;
+  }
+
+  mem_init();
+  printf("[\n");
+  for(int i = optind; i < argc; i++){
+    struct trace t;
+    struct result r = { 0 };
+
+    if(read_trace(argv[i], &t) < 0){
+      failed = 1;
+      continue;
+    }
+    replay_checked(&t, &r);
+    if(r.ok)
+      replay_timed(&t, reps, &r);
+    failed |= !r.ok;
+
+    printf(printed++ ? ",\n" : "");
+    print_result(variant, &t, &r);
+    fflush(stdout);
+    free(t.ops);
+  }
+  printf(printed ? "\n]\n" : "]\n");
+  return failed;
+}
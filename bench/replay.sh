@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# replay.sh - build bench/replay.c against every allocator variant under
+# src/ and replay the given traces with each, printing one JSON array with
+# an object per variant and trace.
+#
+#   bench/replay.sh <handout dir> [-r reps] trace...
+#
+# The handout dir holds memlib.c, memlib.h, mm.h and contracts.h; set
+# $MEMLIB to another memlib directory, e.g. memlib/, to build on that one.
+# Binaries go to $BUILD_DIR (default: a temporary directory), extra
+# compiler flags come from $CFLAGS (default: -O2).
+
+set -e
+
+if [ $# -lt 2 ]; then
+  echo "usage: $0 <handout dir> [-r reps] trace..." >&2
+  exit 1
+fi
+handout=$1
+memlib=${MEMLIB:-$handout}
+shift
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+build=${BUILD_DIR:-$(mktemp -d)}
+mkdir -p "$build"
+
+status=0
+first=1
+echo "["
+for dir in "$root"/src/*/; do
+  name=$(basename "$dir")
+  bin="$build/replay-$(echo "$name" | tr ' ' '-')"
+
+  if ! gcc ${CFLAGS:--O2} -pthread -DDRIVER -DNDEBUG -I"$memlib" -I"$handout" -I"$dir" \
+       -o "$bin" "$root/bench/replay.c" "$dir/mm.c" "$memlib/memlib.c" >&2; then
+    echo "replay.sh: $name does not build" >&2
+    status=1
+    continue
+  fi
+
+  # keep the objects, drop the brackets of each variant's array
+  out=$("$bin" -n "$name" "$@") || status=1
+  objects=$(echo "$out" | grep '^{' | sed 's/,$//') || true
+  [ -z "$objects" ] && continue
+  if [ $first -eq 0 ]; then
+    echo ","
+  fi
+  first=0
+  printf '%s' "$objects" | sed '$!s/$/,/'
+done
+echo
+echo "]"
+exit $status
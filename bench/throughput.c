@@ -0,0 +1,178 @@
+/*
+ * throughput.c - multithreaded malloc/free throughput of one allocator
+ * variant.
+ *
+ * Every thread replays its own random workload (mostly small blocks, some
+ * up to 4KB) against mm_malloc/mm_free, and one block in every
+ * REMOTE_EVERY is handed to the next thread to free, so cross-arena frees
+ * are part of the mix. Runs the workload with 1, 2, 4, ... threads up to
+ * the given maximum and prints the throughput of each run and its speedup
+ * over one thread; with one arena per core the speedup should stay close
+ * to the thread count up to the number of cores.
+ *
+ * Build it next to the handout's memlib.c, mm.h and contracts.h, e.g.
+ *
+ *   gcc -O2 -pthread -DDRIVER -DNDEBUG -I<handout> -o throughput-seg \
+ *       bench/throughput.c "src/segregated free list/mm.c" <handout>/memlib.c
+ *
+ * and run it as
+ *
+ *   ./throughput-seg [max threads] [ops per thread] [live blocks per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define DEFAULT_OPS 2000000
+#define DEFAULT_LIVE 4000
+#define REMOTE_EVERY 64 // one block in this many is freed by another thread
+#define MAILBOX 256 // blocks in flight between two threads
+
+struct worker {
+  pthread_t thread;
+  int id;
+  int nthreads;
+  long ops;
+  long live;
+  void *mailbox[MAILBOX]; // filled by the previous thread, freed by this one
+};
+
+static struct worker *workers;
+
+static uint64_t rng(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// 80% up to 64 bytes, 15% up to 512 bytes, 5% up to 4KB
+static size_t random_size(uint64_t *state) {
+  unsigned int r = rng(state) % 100;
+  if(r < 80)
+    return 1 + rng(state) % 64;
+  if(r < 95)
+    return 1 + rng(state) % 512;
+  return 1 + rng(state) % 4096;
+}
+
+static inline double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *run(void *arg) {
+  struct worker *w = arg;
+  struct worker *next = &workers[(w->id + 1) % w->nthreads];
+  uint64_t state = 0x9E3779B97F4A7C15ULL * (w->id + 1);
+  void **slots = calloc(w->live, sizeof(void *));
+
+  if(slots == NULL){
+    fprintf(stderr, "throughput: out of memory for slots\n");
+    exit(1);
+  }
+
+  for(long i = 0; i < w->ops; i++){
+    long slot = rng(&state) % w->live;
+
+    if(slots[slot] == NULL){
+      size_t size = random_size(&state);
+      if((slots[slot] = mm_malloc(size)) == NULL){
+        fprintf(stderr, "throughput: mm_malloc(%zu) failed\n", size);
+        exit(1);
+      }
+      *(char *) slots[slot] = 1; // touch it like a real caller would
+    }else if(i % REMOTE_EVERY == 0){
+      // pass the block on to the next thread, free one the previous
+      // thread passed on to this one
+      void *mine = __atomic_exchange_n(&next->mailbox[slot % MAILBOX],
+                                       slots[slot], __ATOMIC_ACQ_REL);
+      void *theirs = __atomic_exchange_n(&w->mailbox[slot % MAILBOX],
+                                         NULL, __ATOMIC_ACQ_REL);
+      if(mine != NULL) // still there, the next thread did not get to it
+        mm_free(mine);
+      if(theirs != NULL)
+        mm_free(theirs);
+      slots[slot] = NULL;
+    }else{
+      mm_free(slots[slot]);
+      slots[slot] = NULL;
+    }
+  }
+
+  for(long slot = 0; slot < w->live; slot++){
+    if(slots[slot] != NULL)
+      mm_free(slots[slot]);
+  }
+  free(slots);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = argc > 1 ? atoi(argv[1]) : (int) cores;
+  long ops = argc > 2 ? atol(argv[2]) : DEFAULT_OPS;
+  long live = argc > 3 ? atol(argv[3]) : DEFAULT_LIVE;
+  double base = 0;
+
+  if(max_threads < 1 || ops < 1 || live < 1){
+    fprintf(stderr, "usage: %s [max threads] [ops per thread] [live blocks per thread]\n",
+            argv[0]);
+    return 1;
+  }
+  workers = calloc(max_threads, sizeof(struct worker));
+  if(workers == NULL){
+    fprintf(stderr, "throughput: out of memory for workers\n");
+    return 1;
+  }
+
+  printf("%ld cores, %ld ops per thread, %ld live blocks per thread\n",
+         cores, ops, live);
+  mem_init();
+  for(int n = 1; ; n = n * 2 < max_threads ? n * 2 : max_threads){
+    double start, elapsed;
+
+    mem_reset_brk();
+    if(mm_init() < 0){
+      fprintf(stderr, "throughput: mm_init failed\n");
+      return 1;
+    }
+    memset(workers, 0, max_threads * sizeof(struct worker));
+
+    start = now_s();
+    for(int i = 0; i < n; i++){
+      workers[i].id = i;
+      workers[i].nthreads = n;
+      workers[i].ops = ops;
+      workers[i].live = live;
+      pthread_create(&workers[i].thread, NULL, run, &workers[i]);
+    }
+    for(int i = 0; i < n; i++)
+      pthread_join(workers[i].thread, NULL);
+    elapsed = now_s() - start;
+
+    for(int i = 0; i < n; i++){ // blocks still in the mailboxes
+      for(int j = 0; j < MAILBOX; j++){
+        if(workers[i].mailbox[j] != NULL)
+          mm_free(workers[i].mailbox[j]);
+      }
+    }
+
+    if(n == 1)
+      base = ops / elapsed;
+    printf("%3d threads %8.2f Mops/s  speedup %5.2f\n",
+           n, n * ops / elapsed / 1e6, n * ops / elapsed / base);
+    if(n == max_threads)
+      break;
+  }
+  return 0;
+}
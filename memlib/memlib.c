@@ -0,0 +1,181 @@
+/*
+ * memlib.c - the memory system the allocators run on, backed by one
+ * reserved range of virtual memory.
+ *
+ * mem_init reserves MEM_RESERVE bytes of address space with PROT_NONE and
+ * MAP_NORESERVE, which costs no memory. mem_sbrk moves the break inside
+ * that range and commits pages in steps of MEM_COMMIT_GRAIN as the break
+ * passes them, and a negative mem_sbrk hands the pages above the new break
+ * back to the system and makes them inaccessible again. The heap never
+ * moves, so mem_heap_lo stays put for the life of the process and the
+ * in_heap checks of the allocators stay two comparisons.
+ *
+ * Optional hints, all off by default:
+ *   -DMEM_POPULATE  fault in committed pages right away, so the allocator
+ *                   never takes a page fault on a fresh part of the heap
+ *   -DMEM_HUGEPAGE  align the heap to HUGE_PAGE bytes, commit in huge page
+ *                   steps and ask for transparent huge pages for the range
+ *
+ * Override the sizes with -DMEM_RESERVE=<bytes> and
+ * -DMEM_COMMIT_GRAIN=<bytes>, a multiple of the page size.
+ */
+
+#define _GNU_SOURCE // MADV_HUGEPAGE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "memlib.h"
+
+#ifndef MEM_RESERVE
+#define MEM_RESERVE (64ULL << 30) // address space the heap may grow into
+#endif
+
+#define HUGE_PAGE (2UL << 20)
+
+#ifndef MEM_COMMIT_GRAIN
+#ifdef MEM_HUGEPAGE
+#define MEM_COMMIT_GRAIN HUGE_PAGE
+#else
+#define MEM_COMMIT_GRAIN (64UL << 10) // bytes committed at once
+#endif
+#endif
+
+static char *mem_start_brk; // first byte of the heap
+static char *mem_brk; // first byte past the heap
+static char *mem_commit_brk; // first byte past the committed pages
+static char *mem_max_addr; // end of the reserved range
+static char *mem_map_start; // the reservation as mmap returned it
+static size_t mem_map_length;
+
+// Round p up to a multiple of the commit grain
+static inline char *grain_up(const char *p) {
+  uintptr_t grain = MEM_COMMIT_GRAIN;
+  return (char *) (((uintptr_t) p + grain - 1) & ~(grain - 1));
+}
+
+// Make [mem_commit_brk, end) usable; return -1 on error, 0 on success
+static int commit(char *end) {
+  size_t length = end - mem_commit_brk;
+
+  if(mprotect(mem_commit_brk, length, PROT_READ | PROT_WRITE) < 0)
+    return -1;
+#ifdef MEM_POPULATE
+#ifdef MADV_POPULATE_WRITE
+  if(madvise(mem_commit_brk, length, MADV_POPULATE_WRITE) < 0)
+#endif
+  {
+    // older kernels: touch every page, they are all zero anyway
+    for(size_t i = 0; i < length; i += mem_pagesize())
+      ((volatile char *) mem_commit_brk)[i] = 0;
+  }
+#endif
+  mem_commit_brk = end;
+  return 0;
+}
+
+// Give [start, mem_commit_brk) back to the system and make it inaccessible
+static void decommit(char *start) {
+  if(start >= mem_commit_brk)
+    return;
+  madvise(start, mem_commit_brk - start, MADV_DONTNEED);
+  mprotect(start, mem_commit_brk - start, PROT_NONE);
+  mem_commit_brk = start;
+}
+
+/*
+ * mem_init - reserve the address space of the heap, nothing committed yet
+ */
+void mem_init(void) {
+  size_t align = MEM_COMMIT_GRAIN;
+
+  // reserve one grain more, so the heap can start at a grain boundary
+  mem_map_length = MEM_RESERVE + align;
+  mem_map_start = mmap(NULL, mem_map_length, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(mem_map_start == MAP_FAILED){
+    perror("mem_init: mmap");
+    exit(1);
+  }
+
+  mem_start_brk = grain_up(mem_map_start);
+  mem_max_addr = mem_start_brk + MEM_RESERVE;
+  mem_brk = mem_start_brk;
+  mem_commit_brk = mem_start_brk;
+#ifdef MEM_HUGEPAGE
+  madvise(mem_start_brk, MEM_RESERVE, MADV_HUGEPAGE); // kept by every commit
+#endif
+}
+
+/*
+ * mem_deinit - release the whole range
+ */
+void mem_deinit(void) {
+  munmap(mem_map_start, mem_map_length);
+  mem_map_start = mem_start_brk = mem_brk = mem_commit_brk = mem_max_addr = NULL;
+}
+
+/*
+ * mem_reset_brk - empty the heap and give all of its pages back
+ */
+void mem_reset_brk(void) {
+  mem_brk = mem_start_brk;
+  decommit(mem_start_brk);
+}
+
+/*
+ * mem_sbrk - move the break by incr bytes, which may be negative, and
+ * return its old value, or (void *) -1 with errno ENOMEM if the break
+ * would leave the reserved range or its pages cannot be committed
+ */
+void *mem_sbrk(int incr) {
+  char *old_brk = mem_brk;
+  char *new_brk = mem_brk + incr;
+
+  if(new_brk < mem_start_brk || new_brk > mem_max_addr){
+    errno = ENOMEM;
+    fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+    return (void *) -1;
+  }
+
+  if(new_brk > mem_commit_brk && commit(grain_up(new_brk)) < 0){
+    errno = ENOMEM;
+    return (void *) -1;
+  }
+  if(incr < 0)
+    decommit(grain_up(new_brk));
+  mem_brk = new_brk;
+  return old_brk;
+}
+
+/*
+ * mem_heap_lo - return the address of the first heap byte
+ */
+void *mem_heap_lo(void) {
+  return mem_start_brk;
+}
+
+/*
+ * mem_heap_hi - return the address of the last heap byte
+ */
+void *mem_heap_hi(void) {
+  return mem_brk - 1;
+}
+
+/*
+ * mem_heapsize - return the heap size in bytes
+ */
+size_t mem_heapsize(void) {
+  return mem_brk - mem_start_brk;
+}
+
+/*
+ * mem_pagesize - return the page size of the system
+ */
+size_t mem_pagesize(void) {
+  return (size_t) getpagesize();
+}
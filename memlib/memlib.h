@@ -0,0 +1,20 @@
+/*
+ * memlib.h - the memory system interface every allocator variant is built
+ * on, see memlib.c.
+ */
+
+#ifndef MEMLIB_H
+#define MEMLIB_H
+
+#include <unistd.h>
+
+void mem_init(void);
+void mem_deinit(void);
+void *mem_sbrk(int incr);
+void mem_reset_brk(void);
+void *mem_heap_lo(void);
+void *mem_heap_hi(void);
+size_t mem_heapsize(void);
+size_t mem_pagesize(void);
+
+#endif
@@ -50,24 +50,28 @@
  */
 #define WSIZE 1    // use 4-bytes word size as basic amount of size
 #define DSIZE 2
-#define CHUNKSIZE (1 << 9) // 1024 words
-#define OVERHEAD 2 // normal overhead in word(so it is 2 words)
+#define CHUNKSIZE (1 << 9) // 512 words
+#define OVERHEAD 2 // prologue size in words
+#define MIN_BLOCK 4 // header + prev + succ + footer of a free block, in words
 
 #define FREE 1
 #define ALLOC 0
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
-#define END_OF_LIST 0
+#define END_OF_LIST 0 // offset 0 is the list header, never a block
 
-static uint64_t **explicit_free_list_header;
+static uint32_t *explicit_free_list_header; // offset of the first free block
 static int explicit_free_list_size;
 
 static uint32_t *heap_listp;
+static uint32_t *heap_base; // first word of the heap, all link offsets count from here
 static void *extend_heap(uint32_t words);
 static void *find_fit(uint32_t asize);
 static void place(void *bp, uint32_t asize);
+static void split_tail(void *bp, uint32_t asize);
 static void *coalesce(void *bp);
-static void addFirst(uint64_t **prev, uint64_t **succ);
+static void addFirst(uint32_t *bp);
+static void removeBlock(uint32_t *bp);
 
 /*
  *  Helper functions
@@ -113,7 +117,7 @@ static inline uint32_t* block_hdrp(uint32_t* block) {
 
 // Return the size of the given block in multiples of the word size
 // 结果直接是 size based on word size, 不需要再除以WSIZE
-// 前2位: 0, a/f; 后30位: block size
+// 前2位: prev a/f, a/f; 后30位: block size
 
 // 参数：header / footer
 // 返回：size 
@@ -125,7 +129,8 @@ static inline unsigned int block_size(const uint32_t* block) {
     return (block[0] & 0x3FFFFFFF);
 }
 
-// Return the footer pointer of the pointer points to payload
+// Return the footer pointer of the pointer points to payload,
+// only free blocks have a footer
 
 // 参数：payload
 // 返回：footer
@@ -133,6 +138,7 @@ static inline uint32_t* block_ftrp(uint32_t* block) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
     REQUIRES(aligned(block));
+    REQUIRES(!(block_hdrp(block)[0] & 0x40000000));
 
     return block + block_size(block_hdrp(block)) - DSIZE;
 }
@@ -149,42 +155,57 @@ static inline int block_free(uint32_t* block) {
     return !(block[0] & 0x40000000);
 }
 
-// Mark the given block as free(1)/alloced(0) by marking the header and footer.
+// Return true if the previous block is free, false otherwise
+
+// 参数：header
+// 返回：free(1) / alloc(0)
+static inline int block_prev_free(const uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return !(block[0] & 0x80000000);
+}
+
+// Record in the header whether the previous block is free(1)/alloced(0)
+
+// 参数：header
+// 返回：空
+static inline void block_mark_prev(uint32_t* block, int free) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    block[0] = free ? block[0] & 0x7FFFFFFF : block[0] | 0x80000000;
+}
+
+// Mark the given block as free(1)/alloced(0) by marking the header, the
+// footer of a free block, and the prev bit of the next block's header.
 
 // 参数：header(footer同时完成)
 // 返回：空
 static inline void block_mark(uint32_t* block, int free) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
-    
-    if(block_size(block) == 0){
-      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
-      return;
-    } else {
-      unsigned int next = block_size(block) - 1; // ? 原: block_size(block) + 1
-      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
-      block[next] = block[0]; // 设置footer对应内容
+
+    block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
+    if(block_size(block) == 0) // epilogue or place holder
       return;
-    }
+
+    unsigned int next = block_size(block);
+    if(free)
+      block[next - 1] = block[0]; // 设置footer对应内容
+    block_mark_prev(block + next, free);
 }
 
-// set the block size to both header and footer
+// set the block size in the header, keeping only the prev bit,
+// block_mark writes the footer afterwards
 
-// 参数：header(footer同时完成)
+// 参数：header
 // 返回：空
 static inline void block_set_size(uint32_t* block, uint32_t size_in_words) {
   REQUIRES(block != NULL);
   REQUIRES(in_heap(block));
-  
-  if(size_in_words == 0) { // indicate the block do not have header or footer
-    block[0] = size_in_words;
-    return;
-  } else {
-    unsigned int next = size_in_words - 1;
-    block[0] = size_in_words;
-    block[next] = block[0]; // set footer
-    return;
-  }
+
+  block[0] = size_in_words | (block[0] & 0x80000000);
 }
 
 // Return a pointer to the memory malloc should return
@@ -199,13 +220,15 @@ static inline  uint32_t* block_mem(uint32_t* block) {
     return block + 1;
 }
 
-// Return the head pointer to the previous block
+// Return the head pointer to the previous block, which must be free
+// since only free blocks have a footer
 
 // 参数：header
 // 返回：header
 static inline uint32_t* block_prev(uint32_t* block) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
+    REQUIRES(block_prev_free(block));
 
     return block - block_size(block - WSIZE); // 原: block_size(block - 1) - 1
 }
@@ -223,6 +246,45 @@ static inline uint32_t* block_next(uint32_t* block) {
 }
 
 
+/*
+ *  Link Functions
+ *  --------------
+ *  A free block stores its links as 32-bit word offsets from heap_base
+ *  instead of 8-byte pointers: [header][prev][succ] ... [footer]. The
+ *  first block of the list has no prev.
+ */
+
+// Return the block at offset, NULL for END_OF_LIST
+static inline uint32_t* from_offset(uint32_t offset) {
+    return offset == END_OF_LIST ? NULL : heap_base + offset;
+}
+
+// Return the offset of block p, END_OF_LIST for NULL
+static inline uint32_t to_offset(const uint32_t* p) {
+    return p == NULL ? END_OF_LIST : (uint32_t) (p - heap_base);
+}
+
+// 参数：payload
+// 返回：prev / succ free block payload
+static inline uint32_t* link_prev(const uint32_t* bp) {
+    return from_offset(bp[0]);
+}
+
+static inline uint32_t* link_succ(const uint32_t* bp) {
+    return from_offset(bp[1]);
+}
+
+// 参数：payload, prev / succ free block payload
+// 返回：空
+static inline void link_set_prev(uint32_t* bp, const uint32_t* prev) {
+    bp[0] = to_offset(prev);
+}
+
+static inline void link_set_succ(uint32_t* bp, const uint32_t* succ) {
+    bp[1] = to_offset(succ);
+}
+
+
 /*
  *  Malloc Implementation
  *  ---------------------
@@ -235,19 +297,24 @@ static inline uint32_t* block_next(uint32_t* block) {
 int mm_init(void) {
 
   // init 6 words for explicit free linked list(add explicit_free_list_header)
+  // word 0 holds the list header, word 1 keeps the payloads 8-byte aligned
   if((heap_listp = mem_sbrk(6 * WSIZE * 4)) == NULL)
     return -1;
-  
-  explicit_free_list_header = (uint64_t **) heap_listp;
+
+  heap_base = heap_listp;
+  explicit_free_list_header = heap_listp;
+  *explicit_free_list_header = END_OF_LIST;
   explicit_free_list_size = 0;
 
   heap_listp = heap_listp + 2; // move heap_listp to the old first block
 
+  block_mark_prev(heap_listp, ALLOC);
+  block_mark_prev(heap_listp + WSIZE, ALLOC);
   block_set_size(heap_listp, 0); // set first block for place holder
   block_mark(heap_listp, FREE);
   
   block_set_size(heap_listp + WSIZE, OVERHEAD); // set prologue block for 1st alloc block
-  block_mark(heap_listp + WSIZE, ALLOC);
+  block_mark(heap_listp + WSIZE, ALLOC); // also marks the epilogue's prev bit
 
   block_set_size(heap_listp + WSIZE + DSIZE, 0); // set epilogue block
   block_mark(heap_listp + WSIZE + DSIZE, ALLOC);
@@ -270,17 +337,15 @@ static void *extend_heap(uint32_t words){
   if((long)(bp = mem_sbrk(size)) < 0)  // use long for 64-bits machine!
     return NULL;
   
+  // the old epilogue becomes the header and keeps its prev bit
   block_set_size(block_hdrp(bp), size / 4); // bp is not the header, but the payload pointer
-  block_mark(block_hdrp(bp), FREE);
+  block_mark(block_hdrp(bp), FREE); // footer and the epilogue's prev bit
 
   block_set_size(block_next(block_hdrp(bp)), 0); // set epilogue
   block_mark(block_next(block_hdrp(bp)), ALLOC);
 
   // last-in-first-out explicit-free-list implementation
-  uint64_t **prev = (uint64_t **) bp; // prev pointer of extended free block
-  uint64_t **succ = prev + 1; // succ pointer of extended free block
-
-  addFirst(prev, succ); //LIFO
+  addFirst(bp); //LIFO
 
   return coalesce(bp);
 }
@@ -296,26 +361,45 @@ static void connect_from_one_to_two(uint64_t *para1, uint64_t *para2){
 }
 */
 
-// add free block indicated by prev and succ to the first element in free list
-// 为prev, succ所指向的空间分配实际的数据，也就是指向其他free block的指针
-static void addFirst(uint64_t **prev, uint64_t **succ){
-  
-  // free list is empty(either begin or free list shrinks to empty)
-  if(explicit_free_list_size == 0){
-      *explicit_free_list_header = (uint64_t *) prev;
-      *prev = (uint64_t *) explicit_free_list_header;
-      *succ = END_OF_LIST; // succ points to 0(end of list)
-      explicit_free_list_size++;
-      return;
-  }else{ // free list already exist
-      uint64_t **oldFirstFreePrev = (uint64_t **) *explicit_free_list_header;
-      *explicit_free_list_header = (uint64_t *) prev;
-      *prev = (uint64_t *) explicit_free_list_header;
-      *succ = (uint64_t *) oldFirstFreePrev;
-      *oldFirstFreePrev = (uint64_t *) prev; // free block都是指向前一个或后一个的prev(old payload)
-      explicit_free_list_size++;
-      return;
-  }
+// add free block bp to the first element in free list
+// 为bp的prev, succ分配实际的数据，也就是其他free block的offset
+static void addFirst(uint32_t *bp){
+  uint32_t *first = from_offset(*explicit_free_list_header);
+
+  link_set_prev(bp, NULL);
+  link_set_succ(bp, first); // END_OF_LIST if the free list is empty
+  if(first != NULL)
+    link_set_prev(first, bp); // old first block points back to bp
+  *explicit_free_list_header = to_offset(bp);
+  explicit_free_list_size++;
+}
+
+// take free block bp off the free list
+static void removeBlock(uint32_t *bp){
+  uint32_t *prev = link_prev(bp);
+  uint32_t *succ = link_succ(bp);
+
+  if(prev == NULL) // bp is the first block
+    *explicit_free_list_header = to_offset(succ);
+  else
+    link_set_succ(prev, succ);
+
+  if(succ != NULL)
+    link_set_prev(succ, prev);
+
+  // for safety
+  link_set_prev(bp, NULL);
+  link_set_succ(bp, NULL);
+  explicit_free_list_size--;
+}
+
+// Return the block size in words for a request of size bytes; allocated
+// blocks only pay for the header, but must still be big enough to hold a
+// free block's links and footer once they are freed
+static inline size_t adjust_size(size_t size){
+  size_t asize = 8 * ((size + 4 + (8 - 1)) / 8);
+
+  return MAX(asize / 4, MIN_BLOCK); // convert bytes to words
 }
 
 /*
@@ -330,13 +414,7 @@ void *malloc (size_t size) {
   if(size <= 0)
     return NULL;
 
-  // for explicit free list, minimum size is 24 bytes
-  if(size <= 16) // set actual size
-    asize = 16 + 8;
-  else
-    asize = 8 * ((size + 8 + (8 - 1)) / 8);
-
-  asize = asize / 4; // convert bytes to words
+  asize = adjust_size(size);
 
   if((bp = find_fit(asize)) != NULL){ // find fit place
     place(bp, asize);
@@ -359,7 +437,7 @@ void *malloc (size_t size) {
 static void *find_fit(uint32_t asize){
   
   uint32_t iter_num = explicit_free_list_size;
-  uint64_t **iter_ptr = explicit_free_list_header;
+  uint32_t *iter_ptr = from_offset(*explicit_free_list_header);
   
   uint32_t *best_fit_pointer = NULL;
   uint32_t best_fit_size; // csize - asize
@@ -367,27 +445,25 @@ static void *find_fit(uint32_t asize){
   uint32_t FIRST_TIME_ENTER = 0;
 
   while(iter_num > 0){
-    // first time: move from header to next free block's payload(prev)
-    iter_ptr = (uint64_t **) *iter_ptr;
-    csize = block_size(block_hdrp((uint32_t *)iter_ptr));
+    csize = block_size(block_hdrp(iter_ptr));
     if(asize <= csize){
       if(FIRST_TIME_ENTER == 0){
         best_fit_size = csize - asize;
-        best_fit_pointer = (uint32_t *)iter_ptr;
+        best_fit_pointer = iter_ptr;
         FIRST_TIME_ENTER = 1;
       }else{
         if(csize - asize < best_fit_size){
-          best_fit_pointer = (uint32_t *)iter_ptr;
+          best_fit_pointer = iter_ptr;
           best_fit_size = csize - asize;
         }
       }
       if(best_fit_size < 250) // set阀值to200wds, optimal for explicit free list, LIFO
         break;
     }
-    iter_ptr++; // move to the succ pointer of this free block
+    iter_ptr = link_succ(iter_ptr); // move to the next free block
     iter_num--;
-    if(iter_num == 0 && *iter_ptr != END_OF_LIST){
-      printf(" runtime error: in find_fit(), when iter_num is 0, *iter_ptr != EOL\n");
+    if(iter_num == 0 && iter_ptr != NULL){
+      printf(" runtime error: in find_fit(), when iter_num is 0, iter_ptr != EOL\n");
     }
   }
   if(best_fit_pointer == NULL)
@@ -400,84 +476,59 @@ static void place(void *bp, uint32_t asize){
   //printf("enter place\n");
   uint32_t csize = block_size(block_hdrp(bp));
   
-  // explicit free list, splitting condition is 24 bytes(6 words)
-  if((csize - asize) >= (DSIZE + OVERHEAD + 2)){ // split the block
+  // explicit free list, splitting condition is 16 bytes(4 words)
+  if((csize - asize) >= MIN_BLOCK){ // split the block
+    uint32_t *prev = link_prev(bp); // 暂存bp的free list中的前后位置
+    uint32_t *succ = link_succ(bp);
+
     block_set_size(block_hdrp(bp), asize);
     block_mark(block_hdrp(bp), ALLOC);
-    
-    uint64_t **bp_prevblock_prev = (uint64_t **) *(uint64_t **)bp; // 暂存bp的free list中的前后位置
-    uint64_t **bp_succblock_prev = (uint64_t **) *((uint64_t **)bp + 1);
 
     bp = block_mem(block_next(block_hdrp(bp))); // bp points to next split block's payload
     
     block_set_size(block_hdrp(bp), csize - asize);
     block_mark(block_hdrp(bp), FREE);
     
-    // 平移 2 pointers to the next split block's prev and succ's position
-    *(uint64_t **)bp = (uint64_t *) bp_prevblock_prev;
-    *((uint64_t **)bp + 1) = (uint64_t *) bp_succblock_prev;
-    
-    if(bp_prevblock_prev == explicit_free_list_header && 
-      bp_succblock_prev == END_OF_LIST){ // old bp is the only free block in free list
-      *explicit_free_list_header = (uint64_t *) bp;
-      // this time, size should be 1
-      if(explicit_free_list_size != 1){
-        printf(" runtime error: in place(), explicit_free_list_size should be 1 when placing the only block with splitting\n");
-      }
-      return;
-    }else if(bp_prevblock_prev == explicit_free_list_header){ // old bp is the first block in free list
-      *explicit_free_list_header = (uint64_t *) bp;
-      *bp_succblock_prev = (uint64_t *)bp; //~~~~~~~~~~~~~~~~~~~~~~~~
-      return;
-    }else if(bp_succblock_prev == END_OF_LIST){
-      uint64_t **bp_prevblock_succ = bp_prevblock_prev + 1;
-      *bp_prevblock_succ = (uint64_t *)bp; //~~~~~~~~~~~~~~~~~~~~~~~~
-      return;
-    }else{
-      uint64_t **bp_prevblock_succ = bp_prevblock_prev + 1;
-      *bp_prevblock_succ = (uint64_t *)bp;
-      *bp_succblock_prev = (uint64_t *)bp; //~~~~~~~~~~~~~~~~~~~~~~~~
-      return;
-    }
+    // 平移 2 links to the next split block, it keeps bp's place in free list
+    link_set_prev(bp, prev);
+    link_set_succ(bp, succ);
+    if(prev == NULL) // old bp is the first block in free list
+      *explicit_free_list_header = to_offset(bp);
+    else
+      link_set_succ(prev, bp);
+    if(succ != NULL)
+      link_set_prev(succ, bp);
+    return;
   }
 
   else{ // do not split the block
+    removeBlock(bp);
     block_set_size(block_hdrp(bp), csize);
     block_mark(block_hdrp(bp), ALLOC);
-
-    uint64_t **bp_prevblock_prev = (uint64_t **) *(uint64_t **)bp;
-    uint64_t **bp_succblock_prev = (uint64_t **) *((uint64_t **)bp + 1);
-    
-    // header也需要判断，因为header没有prev与succ之分
-    if(bp_prevblock_prev == explicit_free_list_header && // place block's prev points to list head
-      bp_succblock_prev == END_OF_LIST){ // place block's succ points to EOL
-      *explicit_free_list_header = END_OF_LIST;
-      explicit_free_list_size--; 
-      // size should be 0
-      if(explicit_free_list_size != 0){
-        printf(" runtime error: in place(), explicit_free_list_size should be 0 when placing the only block without splitting\n");
-      }
-      return;
-    }else if(bp_succblock_prev == END_OF_LIST){
-      uint64_t **bp_prevblock_succ = bp_prevblock_prev + 1;
-      *bp_prevblock_succ = END_OF_LIST;
-      explicit_free_list_size--;
-      return;
-    }else if(bp_prevblock_prev == explicit_free_list_header){
-      *explicit_free_list_header = (uint64_t *) bp_succblock_prev;
-      *bp_succblock_prev = (uint64_t *) explicit_free_list_header;
-      explicit_free_list_size--; 
-      return;
-    }else{ // no special condition
-      uint64_t **bp_prevblock_succ = bp_prevblock_prev + 1;
-      *bp_prevblock_succ = (uint64_t *) bp_succblock_prev;
-      *bp_succblock_prev = (uint64_t *) bp_prevblock_prev;
-      explicit_free_list_size--;
-      return;
-    }
+    return;
   }
 }
 
+// cut allocated block bp down to asize words and free the tail, as long as
+// the tail is big enough to be a block of its own
+static void split_tail(void *bp, uint32_t asize){
+  uint32_t csize = block_size(block_hdrp(bp));
+
+  if((csize - asize) < MIN_BLOCK) // do not split the block
+    return;
+
+  block_set_size(block_hdrp(bp), asize);
+  block_mark(block_hdrp(bp), ALLOC);
+
+  bp = block_mem(block_next(block_hdrp(bp))); // bp points to the tail's payload
+
+  block_set_size(block_hdrp(bp), csize - asize);
+  block_mark(block_hdrp(bp), FREE);
+
+  addFirst(bp);
+  coalesce(bp); // the tail may touch a free next block
+}
+
 
 /*
  * free
@@ -489,18 +540,16 @@ void free(void *bp) {
   checkheap(1);
   block_mark(block_hdrp(bp), FREE);
   
-  uint64_t **prev = (uint64_t **) bp;
-  uint64_t **succ = prev + 1;
-
-  addFirst(prev, succ);
+  addFirst(bp);
 
   coalesce(bp);
   checkheap(1);
 }
 
+// bp must be the first block in free list
 static void *coalesce(void *bp){
 
-  int prev_alloc = block_free(block_prev(block_hdrp(bp)));
+  int prev_alloc = block_prev_free(block_hdrp(bp));
 
   int next_alloc = block_free(block_next(block_hdrp(bp)));
 
@@ -512,164 +561,44 @@ static void *coalesce(void *bp){
   }
 
   else if(!prev_alloc && next_alloc){ // merge next
-    // Last-In-First-Out Strategy
-    // bp's next block's prev pointer
-    uint64_t **bp_physicnext_prev = (uint64_t **) block_mem(block_next(block_hdrp(bp)));
-    // bp's next block's succ pointer
-    uint64_t **bp_physicnext_succ = bp_physicnext_prev + 1;
+    // Last-In-First-Out Strategy, bp stays first in free list
+    removeBlock(block_mem(block_next(block_hdrp(bp))));
 
-    // merge next，所以下面三行语句必须放在上面两行语句的下面
     size += block_size(block_next(block_hdrp(bp)));
     block_set_size(block_hdrp(bp), size);
     block_mark(block_hdrp(bp), FREE);
-    
-    // for LIFO, bp的物理next的prev不可能指向header
-    if(*bp_physicnext_succ == END_OF_LIST){ // if bp的 物理next的succ指向END OF LIST
-      //uint64_t **bp_physicnext_prevblock_prev = (uint64_t **) *bp_physicnext_prev;
-      uint64_t **bp_physicnext_prevblock_succ = ((uint64_t **) *bp_physicnext_prev) + 1;
-
-      *bp_physicnext_prevblock_succ = END_OF_LIST;
-    }else{ // bp的 物理next的succ不指向EOL
-      uint64_t **bp_physicnext_prevblock_prev = (uint64_t **) *bp_physicnext_prev;
-      uint64_t **bp_physicnext_succblock_prev = (uint64_t **) *bp_physicnext_succ;
-      uint64_t **bp_physicnext_prevblock_succ = ((uint64_t **) *bp_physicnext_prev) + 1;
-  
-      *bp_physicnext_prevblock_succ = (uint64_t *) bp_physicnext_succblock_prev;
-      // 如果不加判断，这一步解引用会出错，因为bp_physicnext_succblock_prev可能为0
-      *bp_physicnext_succblock_prev = (uint64_t *) bp_physicnext_prevblock_prev;
-    }
-    
-    // for safety, no pointer points to these two pointers now
-    *bp_physicnext_prev = 0;
-    *bp_physicnext_succ = 0;
-
-    explicit_free_list_size--;
     return bp;
   }
 
   else if(prev_alloc && !next_alloc){ // merge prev
-    size += block_size(block_prev(block_hdrp(bp)));
-    block_set_size(block_prev(block_hdrp(bp)), size);
-    block_mark(block_prev(block_hdrp(bp)), FREE);
-    
-    // Last-In-First-Out Strategy
-    // bp's prev block's prev pointer
-    uint64_t **bp_physicprev_prev = (uint64_t **) block_mem(block_prev(block_hdrp(bp)));
-    // bp's prev block's succ pointer
-    uint64_t **bp_physicprev_succ = bp_physicprev_prev + 1;
-
-    if(*bp_physicprev_succ == END_OF_LIST){ // bp的物理prev的succ指向EOL
-      //uint64_t **bp_physicprev_prevblock_prev = (uint64_t **) *bp_physicprev_prev;
-      uint64_t **bp_physicprev_prevblock_succ = ((uint64_t **) *bp_physicprev_prev) + 1;
-
-      *bp_physicprev_prevblock_succ = END_OF_LIST;
-    }else{
-      uint64_t **bp_physicprev_prevblock_prev = (uint64_t **) *bp_physicprev_prev;
-      uint64_t **bp_physicprev_prevblock_succ = ((uint64_t **) *bp_physicprev_prev) + 1;
-      uint64_t **bp_physicprev_succblock_prev = (uint64_t **) *bp_physicprev_succ;
-
-      *bp_physicprev_prevblock_succ = (uint64_t *) bp_physicprev_succblock_prev;
-      *bp_physicprev_succblock_prev = (uint64_t *) bp_physicprev_prevblock_prev;
-    }
-    
-    /////////////////////////////////////
-    uint64_t **header = (uint64_t **) (*(uint64_t **) bp); // for LIFO, it must be the header
-    if(header != explicit_free_list_header){
-      printf(" runtime error: in coalesce(), the prev of the LIFO free block is not header\n");
-      return NULL;
-    }
-    *header = (uint64_t *) bp_physicprev_prev;
+    // Last-In-First-Out Strategy, bp's physical prev takes bp's place
+    // first in free list
+    removeBlock(bp);
+    bp = block_mem(block_prev(block_hdrp(bp)));
+    removeBlock(bp);
 
-    uint64_t **bp_succblock_prev = (uint64_t **) *((uint64_t **)bp + 1);
-    if(bp_succblock_prev == END_OF_LIST){ // if bp's succ points to EOL(can happen)
-      // do nothing
-    }else{
-      *bp_succblock_prev = (uint64_t *) bp_physicprev_prev;
-    }
-    /////////////////////////////////////
+    size += block_size(block_hdrp(bp));
+    block_set_size(block_hdrp(bp), size);
+    block_mark(block_hdrp(bp), FREE);
 
-    *bp_physicprev_prev = *((uint64_t **) bp);
-    *bp_physicprev_succ = *((uint64_t **) bp + 1); //~~~~~~~~~~~~~~~~~~~~~~~~
-    
-    // for safety
-    *((uint64_t **)bp) = 0;
-    *((uint64_t **)bp + 1) = 0;
-    
-    explicit_free_list_size--;
-    return block_mem(block_prev(block_hdrp(bp)));
+    addFirst(bp);
+    return bp;
   }
 
   else{ // merge prev and next
-    size += block_size(block_prev(block_hdrp(bp))) + 
-            block_size(block_next(block_hdrp(bp)));
-
-    block_set_size(block_prev(block_hdrp(bp)), size);
-    block_mark(block_prev(block_hdrp(bp)), FREE);
-    
-    /* Deal with its physical next block */
-    uint64_t **bp_physicnext_prev = (uint64_t **) block_mem(block_next(block_hdrp(bp)));
-    uint64_t **bp_physicnext_succ = bp_physicnext_prev + 1;
-     
-    if(*bp_physicnext_succ == END_OF_LIST){
-      //uint64_t **bp_physicnext_prevblock_prev = (uint64_t **) *bp_physicnext_prev;
-      uint64_t **bp_physicnext_prevblock_succ = ((uint64_t **) *bp_physicnext_prev) + 1;
-
-      *bp_physicnext_prevblock_succ = END_OF_LIST;
-    }else{
-      uint64_t **bp_physicnext_prevblock_prev = (uint64_t **) *bp_physicnext_prev;
-      uint64_t **bp_physicnext_prevblock_succ = ((uint64_t **) *bp_physicnext_prev) + 1;
-      uint64_t **bp_physicnext_succblock_prev = (uint64_t **) *bp_physicnext_succ;
-
-      *bp_physicnext_prevblock_succ = (uint64_t *) bp_physicnext_succblock_prev;
-      *bp_physicnext_succblock_prev = (uint64_t *) bp_physicnext_prevblock_prev;
-    }
-
-    // for safety, no pointer points to these two pointers now
-    *bp_physicnext_prev = 0;
-    *bp_physicnext_succ = 0;
-
-    /* Deal with its physical prev block */
-    uint64_t **bp_physicprev_prev = (uint64_t **) block_mem(block_prev(block_hdrp(bp)));
-    uint64_t **bp_physicprev_succ = bp_physicprev_prev + 1;
-    
-    if(*bp_physicprev_succ == END_OF_LIST){
-      //uint64_t **bp_physicprev_prevblock_prev = (uint64_t **) *bp_physicprev_prev;
-      uint64_t **bp_physicprev_prevblock_succ = ((uint64_t **) *bp_physicprev_prev) + 1;
-
-      *bp_physicprev_prevblock_succ = END_OF_LIST;
-    }else{
-      uint64_t **bp_physicprev_prevblock_prev = (uint64_t **) *bp_physicprev_prev;
-      uint64_t **bp_physicprev_prevblock_succ = ((uint64_t **) *bp_physicprev_prev) + 1;
-      uint64_t **bp_physicprev_succblock_prev = (uint64_t **) *bp_physicprev_succ;
-
-      *bp_physicprev_prevblock_succ = (uint64_t *) bp_physicprev_succblock_prev;
-      *bp_physicprev_succblock_prev = (uint64_t *) bp_physicprev_prevblock_prev;
-    }
-    
+    removeBlock(block_mem(block_next(block_hdrp(bp))));
+    size += block_size(block_next(block_hdrp(bp)));
 
-    uint64_t **header = (uint64_t **) (*(uint64_t **) bp); // for LIFO, it must be the header
-    if(header != explicit_free_list_header){
-      printf(" runtime error: in coalesce(), the prev of the LIFO free block is not header\n");
-      return NULL;
-    }
-    *header = (uint64_t *) bp_physicprev_prev;
+    removeBlock(bp);
+    bp = block_mem(block_prev(block_hdrp(bp)));
+    removeBlock(bp);
 
-    uint64_t **bp_succblock_prev = (uint64_t **) *((uint64_t **)bp + 1);
-    if(bp_succblock_prev == END_OF_LIST){
-      // do nothing
-    }else{
-      *bp_succblock_prev = (uint64_t *) bp_physicprev_prev;
-    }
+    size += block_size(block_hdrp(bp));
+    block_set_size(block_hdrp(bp), size);
+    block_mark(block_hdrp(bp), FREE);
 
-    *bp_physicprev_prev = *((uint64_t **)bp);
-    *bp_physicprev_succ = *((uint64_t **)bp + 1); //~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    
-    // for safety
-    *((uint64_t **)bp) = 0;
-    *((uint64_t **)bp + 1) = 0;
-    
-    explicit_free_list_size = explicit_free_list_size - 2;
-    return block_mem(block_prev(block_hdrp(bp)));
+    addFirst(bp);
+    return bp;
   }
 }
 
@@ -680,6 +609,8 @@ static void *coalesce(void *bp){
 void *realloc(void *oldptr, size_t size) {
   //printf("enter realloc\n");
   size_t oldsize;
+  size_t asize;
+  size_t avail;
   void *newptr;
   checkheap(1);
   if(size == 0){
@@ -693,13 +624,43 @@ void *realloc(void *oldptr, size_t size) {
     return malloc(size);
   }
 
+  asize = adjust_size(size);
+
+  uint32_t *hdr = block_hdrp(oldptr);
+  uint32_t *next = block_next(hdr);
+  avail = block_size(hdr); // what oldptr can get without moving
+
+  if(block_free(next))
+    avail += block_size(next);
+
+  if(asize > avail &&
+    block_size(block_free(next) ? block_next(next) : next) == 0){
+    // oldptr is the last block, maybe followed by one free block: grow the
+    // heap, extend_heap merges the new space into a free block after oldptr
+    if(extend_heap(MAX(asize - avail, CHUNKSIZE)) == NULL)
+      return NULL;
+    next = block_next(hdr);
+    avail = block_size(hdr) + block_size(next);
+  }
+
+  if(asize <= avail){
+    if(avail > block_size(hdr)){ // take over the free next block
+      removeBlock(block_mem(next));
+      block_set_size(hdr, avail);
+      block_mark(hdr, ALLOC);
+    }
+    split_tail(oldptr, asize); // shrink in place, or give back what is left over
+    checkheap(1);
+    return oldptr;
+  }
+
   newptr = malloc(size);
 
   if(!newptr){
     return 0;
   }
   
-  oldsize = block_size(block_hdrp(oldptr));
+  oldsize = block_size(block_hdrp(oldptr)) - 1; // payload, no footer
   oldsize *= 4;
   //oldsize = GET_SIZE(HDRP(oldptr));
   if(size < oldsize) // convert words to bytes
@@ -742,14 +703,6 @@ int mm_checkheap(int verbose) {
           printf(" checkheap: prologue header free/alloc bit error\n");
           return 1;
         }
-        if(block_size(heap_listp) != 2){
-          printf(" checkheap: prologue footer size error\n");
-          return 1;
-        }
-        if(block_free(heap_listp) != 0){
-          printf(" checkheap: prologue footer free/alloc bit error\n");
-          return 1;
-        }
 
         // check heap boundary(first block next to explicit_free_list_header)
         // check epilogue block
@@ -772,8 +725,8 @@ int mm_checkheap(int verbose) {
     
         // check each block's address alignment
         /* check each block's header and footer: minimum size, alignment, 
-           bit consistency, header and footer matching, 
-           no two consecutive free blocks */
+           bit consistency, header and footer matching of free blocks,
+           prev bit matching the previous block, no two consecutive free blocks */
         uint32_t *ptr = heap_listp;
         uint32_t free_block_flag = 0;
 
@@ -784,8 +737,9 @@ int mm_checkheap(int verbose) {
               printf(" checkheap: payload block alignment problem\n");
               return 1;
             }
-            if(aligned(block_ftrp(ptr)) != 1){
-              printf(" checkheap: footer block alignment problem\n");
+            if(block_prev_free(block_next(block_hdrp(ptr))) !=
+               block_free(block_hdrp(ptr))){
+              printf(" checkheap: prev bit in next header does not match this block\n");
               return 1;
             }
             if(ptr == heap_listp){
@@ -794,18 +748,24 @@ int mm_checkheap(int verbose) {
                 return 1;
               }
             }else{
-              if(block_size(block_hdrp(ptr)) < 6){
-                printf(" checkheap: size in header less than 6-words-minimum for explicit free list\n");
+              if(block_size(block_hdrp(ptr)) < MIN_BLOCK){
+                printf(" checkheap: size in header less than 4-words-minimum for explicit free list\n");
                 return 1;
               }
             }
-            if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
-              printf(" checkheap: size in header not equal to size in footer\n");
-              return 1;
-            }
-            if(block_free(block_hdrp(ptr)) != block_free(block_ftrp(ptr))){
-              printf(" checkheap: free/alloc bit in header not equal to free/alloc bit in footer\n");
-              return 1;
+            if(block_free(block_hdrp(ptr))){ // only free blocks have a footer
+              if(aligned(block_ftrp(ptr)) != 1){
+                printf(" checkheap: footer block alignment problem\n");
+                return 1;
+              }
+              if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
+                printf(" checkheap: size in header not equal to size in footer\n");
+                return 1;
+              }
+              if(block_free(block_ftrp(ptr)) != 1){
+                printf(" checkheap: free/alloc bit in header not equal to free/alloc bit in footer\n");
+                return 1;
+              }
             }
 
             // check no two consecutive free blocks
@@ -848,43 +808,32 @@ int mm_checkheap(int verbose) {
           return 1;
         }
 
-        uint64_t **iter_explicit_free_list = explicit_free_list_header;
+        uint32_t *iter_explicit_free_list = from_offset(*explicit_free_list_header);
+        uint32_t *iter_explicit_free_list_prev = NULL;
 
-        int freeblock_num_traverse = 0; // free block count by traversing through pointers
+        int freeblock_num_traverse = 0; // free block count by traversing through links
 
-        while(*iter_explicit_free_list != END_OF_LIST){
-          if(*iter_explicit_free_list < (uint64_t *) mem_heap_lo() ||
-             *iter_explicit_free_list >= (uint64_t *) mem_heap_hi()){
+        while(iter_explicit_free_list != NULL){
+          if(!in_heap(iter_explicit_free_list)){
             printf(" checkheap: free list pointer is not between mem_heap_lo and mem_heap_hi\n");
             return 1;
           }
-
-          if(iter_explicit_free_list == explicit_free_list_header){ // header指针与后指针的consistency检查
-            uint64_t **header_linknext_prev = (uint64_t **) *iter_explicit_free_list;
-            if(iter_explicit_free_list != (uint64_t **) *header_linknext_prev){
-              printf(" checkheap: header linknext's prev != header");
-              return 1;
-            }
-            // 直接到next free block,因为header没有succ
-            iter_explicit_free_list = (uint64_t **) *iter_explicit_free_list;
-            freeblock_num_traverse++;
-            continue;
-          }else{ // 需要将iter指针向后移动一格至其succ处
-            uint64_t **iter_explicit_free_list_succ = iter_explicit_free_list + 1;
-            if(*iter_explicit_free_list_succ == END_OF_LIST){
-              break;
-            }
-            uint64_t **iter_explicit_free_list_succ_linknext_prev = 
-                                      (uint64_t **) *iter_explicit_free_list_succ;
-            if(iter_explicit_free_list != 
-                                      (uint64_t **) *iter_explicit_free_list_succ_linknext_prev){
-              printf(" checkheap: iter succ linknext's prev != iter prev\n");
-              return 1;
-            }
-            // move to the next free block
-            iter_explicit_free_list = (uint64_t **) *iter_explicit_free_list_succ;
-            freeblock_num_traverse++;
+          if(block_free(block_hdrp(iter_explicit_free_list)) != 1){
+            printf(" checkheap: allocated block in free list\n");
+            return 1;
+          }
+          // 前后指针的consistency检查, the first block has no prev
+          if(link_prev(iter_explicit_free_list) != iter_explicit_free_list_prev){
+            printf(" checkheap: iter succ linknext's prev != iter prev\n");
+            return 1;
+          }
+          if(freeblock_num_traverse++ > freeblock_num_iterate){
+            printf(" checkheap: free list has a cycle\n");
+            return 1;
           }
+          // move to the next free block
+          iter_explicit_free_list_prev = iter_explicit_free_list;
+          iter_explicit_free_list = link_succ(iter_explicit_free_list);
         }
 
         if(freeblock_num_traverse != freeblock_num_iterate){
@@ -127,7 +127,8 @@ static inline uint32_t* block_next(uint32_t* const block) {
 #define WSIZE 4
 #define DSIZE 8
 #define CHUNKSIZE (1 << 12)
-#define OVERHEAD 8
+#define OVERHEAD 8 // prologue size
+#define MIN_BLOCK DSIZE // header and footer of a free block
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
@@ -136,8 +137,14 @@ static inline uint32_t* block_next(uint32_t* const block) {
 #define GET(p) (*(uint32_t *)(p))
 #define PUT(p, val) (*(uint32_t *)(p) = (val))
 
-#define GET_SIZE(p) (GET(p) & ~0x7)
+// bit 31 of a header is set if the previous block is allocated, so only
+// free blocks need a footer
+#define PREV_ALLOC 0x80000000
+#define GET_SIZE(p) (GET(p) & 0x7FFFFFF8)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+#define SET_PREV_ALLOC(p) PUT(p, GET(p) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(p) PUT(p, GET(p) & ~PREV_ALLOC)
 
 #define HDRP(bp) ((char *)(bp) - WSIZE)
 #define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
@@ -145,10 +152,16 @@ static inline uint32_t* block_next(uint32_t* const block) {
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
+// compile with -DNEXT_FIT to resume every search where the last one ended
+// instead of at the start of the heap
 static char *heap_listp;
+#ifdef NEXT_FIT
+static char *rover; // payload of the block the next search starts at
+#endif
 static void *extend_heap(uint32_t words);
 static void *find_fit(uint32_t asize);
 static void place(void *bp, uint32_t asize);
+static void split_tail(void *bp, uint32_t asize);
 static void *coalesce(void *bp);
 
 /*
@@ -166,10 +179,12 @@ int mm_init(void) {
     return -1;
 
   PUT(heap_listp, 0);
-  PUT(heap_listp + WSIZE, PACK(OVERHEAD, 1));
-  PUT(heap_listp + DSIZE, PACK(OVERHEAD, 1));
-  PUT(heap_listp + WSIZE + DSIZE, PACK(0, 1));
+  PUT(heap_listp + WSIZE, PACK(OVERHEAD, 1) | PREV_ALLOC); // prologue, no footer
+  PUT(heap_listp + WSIZE + DSIZE, PACK(0, 1) | PREV_ALLOC);
   heap_listp += DSIZE;
+#ifdef NEXT_FIT
+  rover = heap_listp;
+#endif
 
   if(extend_heap(CHUNKSIZE / WSIZE) == NULL)
     return -1;
@@ -186,13 +201,20 @@ static void *extend_heap(uint32_t words){
   if((long)(bp = mem_sbrk(size)) < 0)  // use long for 64-bits machine!
     return NULL;
 
-  PUT(HDRP(bp), PACK(size, 0));
+  // the old epilogue becomes the header and keeps its prev bit
+  PUT(HDRP(bp), PACK(size, 0) | GET_PREV_ALLOC(HDRP(bp)));
   PUT(FTRP(bp), PACK(size, 0));
   PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // epilogue block
   //printf("exit extend_heap\n");
   return coalesce(bp);
 }
 
+// Return the block size in bytes for a request of size bytes, allocated
+// blocks only pay for the header
+static inline size_t adjust_size(size_t size){
+  return MAX(DSIZE * ((size + WSIZE + (DSIZE - 1)) / DSIZE), MIN_BLOCK);
+}
+
 /*
  * malloc
  */
@@ -206,10 +228,7 @@ void *malloc (size_t size) {
   if(size <= 0)
     return NULL;
 
-  if(size <= DSIZE)
-    asize = DSIZE + OVERHEAD;
-  else
-    asize = DSIZE * ((size + OVERHEAD + (DSIZE - 1)) / DSIZE);
+  asize = adjust_size(size);
 
   if((bp = find_fit(asize)) != NULL){ // find fit place
     place(bp, asize);
@@ -227,6 +246,21 @@ void *malloc (size_t size) {
 
 static void *find_fit(uint32_t asize){
   //printf("enter find_fit\n");
+#ifdef NEXT_FIT
+  char *oldrover = rover;
+
+  // from the rover to the end of the heap, then from the start up to it
+  for(; GET_SIZE(HDRP(rover)) > 0; rover = NEXT_BLKP(rover)){
+    if(!GET_ALLOC(HDRP(rover)) && (asize <= GET_SIZE(HDRP(rover)))){
+      return rover;
+    }
+  }
+  for(rover = heap_listp; rover < oldrover; rover = NEXT_BLKP(rover)){
+    if(!GET_ALLOC(HDRP(rover)) && (asize <= GET_SIZE(HDRP(rover)))){
+      return rover;
+    }
+  }
+#else
   void *bp;
   
   for(bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)){
@@ -234,6 +268,7 @@ static void *find_fit(uint32_t asize){
       return bp;
     }
   }
+#endif
   //printf("exit find_fit\n");
   return NULL;
 }
@@ -242,20 +277,35 @@ static void place(void *bp, uint32_t asize){
   //printf("enter place\n");
   uint32_t csize = GET_SIZE(HDRP(bp));
 
-  if((csize - asize) >= (DSIZE + OVERHEAD)){
-    PUT(HDRP(bp), PACK(asize, 1));
-    PUT(FTRP(bp), PACK(asize, 1));
+  if((csize - asize) >= MIN_BLOCK){
+    PUT(HDRP(bp), PACK(asize, 1) | GET_PREV_ALLOC(HDRP(bp)));
     bp = NEXT_BLKP(bp);
-    PUT(HDRP(bp), PACK(csize - asize, 0));
+    PUT(HDRP(bp), PACK(csize - asize, 0) | PREV_ALLOC);
     PUT(FTRP(bp), PACK(csize - asize, 0));
   }
   else{
-    PUT(HDRP(bp), PACK(csize, 1));
-    PUT(FTRP(bp), PACK(csize, 1));
+    PUT(HDRP(bp), PACK(csize, 1) | GET_PREV_ALLOC(HDRP(bp)));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
   }
   //printf("exit place\n");
 }
 
+// cut allocated block bp down to asize bytes and free the tail, as long as
+// the tail is big enough to be a block of its own
+static void split_tail(void *bp, uint32_t asize){
+  uint32_t csize = GET_SIZE(HDRP(bp));
+
+  if((csize - asize) < MIN_BLOCK)
+    return;
+
+  PUT(HDRP(bp), PACK(asize, 1) | GET_PREV_ALLOC(HDRP(bp)));
+  bp = NEXT_BLKP(bp);
+  PUT(HDRP(bp), PACK(csize - asize, 0) | PREV_ALLOC);
+  PUT(FTRP(bp), PACK(csize - asize, 0));
+  CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+  coalesce(bp); // the tail may touch a free next block
+}
+
 
 /*
  * free
@@ -269,17 +319,18 @@ void free (void *ptr) {
   //printf("enter free\n");
   uint32_t size = GET_SIZE(HDRP(ptr));
   //printf("size = %d\n", size);
-  PUT(HDRP(ptr), PACK(size, 0));
+  PUT(HDRP(ptr), PACK(size, 0) | GET_PREV_ALLOC(HDRP(ptr)));
   //printf("Here1\n");
   PUT(FTRP(ptr), PACK(size, 0));
   //printf("Here2\n");
+  CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
   coalesce(ptr);
   //printf("exit free\n");
 }
 
 static void *coalesce(void *bp){
   //printf("enter coalesce\n");
-  uint32_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+  uint32_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
   //printf("prev_alloc = %x\n", prev_alloc);
   uint32_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
   //printf("next_alloc = %x\n", next_alloc);
@@ -291,29 +342,35 @@ static void *coalesce(void *bp){
     return bp;
   }
 
+  // the block in front of a free block is always allocated, so every
+  // merged header gets PREV_ALLOC
   else if(prev_alloc && !next_alloc){ // merge next
     size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-    PUT(HDRP(bp), PACK(size, 0));
+    PUT(HDRP(bp), PACK(size, 0) | PREV_ALLOC);
     PUT(FTRP(bp), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return (bp);
   }
 
   else if(!prev_alloc && next_alloc){ // merge prev
     size += GET_SIZE(HDRP(PREV_BLKP(bp)));
     PUT(FTRP(bp), PACK(size, 0));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return (PREV_BLKP(bp));
+    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0) | PREV_ALLOC);
+    bp = PREV_BLKP(bp);
   }
 
   else{ // merge prev and next
-    size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp)));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+    size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(HDRP(NEXT_BLKP(bp)));
+    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0) | PREV_ALLOC);
     PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return (PREV_BLKP(bp));
+    bp = PREV_BLKP(bp);
   }
+
+#ifdef NEXT_FIT
+  // the rover must not be left inside the merged block
+  if(rover > (char *) bp && rover < NEXT_BLKP(bp))
+    rover = bp;
+#endif
+  //printf("exit coalesce\n");
+  return bp;
 }
 
 
@@ -323,6 +380,9 @@ static void *coalesce(void *bp){
 void *realloc(void *oldptr, size_t size) {
   //printf("enter realloc\n");
   size_t oldsize;
+  size_t asize;
+  size_t avail;
+  char *next;
   void *newptr;
 
   if(size == 0){
@@ -336,13 +396,44 @@ void *realloc(void *oldptr, size_t size) {
     return malloc(size);
   }
 
+  asize = adjust_size(size);
+  next = NEXT_BLKP(oldptr);
+  avail = GET_SIZE(HDRP(oldptr)); // what oldptr can get without moving
+
+  if(!GET_ALLOC(HDRP(next)))
+    avail += GET_SIZE(HDRP(next));
+
+  if(asize > avail &&
+    GET_SIZE(HDRP(GET_ALLOC(HDRP(next)) ? next : NEXT_BLKP(next))) == 0){
+    // oldptr is the last block, maybe followed by one free block: grow the
+    // heap, extend_heap merges the new space into a free block after oldptr
+    if(extend_heap(MAX(asize - avail, CHUNKSIZE) / WSIZE) == NULL)
+      return 0;
+    next = NEXT_BLKP(oldptr);
+    avail = GET_SIZE(HDRP(oldptr)) + GET_SIZE(HDRP(next));
+  }
+
+  if(asize <= avail){
+    if(avail > GET_SIZE(HDRP(oldptr))){ // take over the free next block
+      PUT(HDRP(oldptr), PACK(avail, 1) | GET_PREV_ALLOC(HDRP(oldptr)));
+      SET_PREV_ALLOC(HDRP(NEXT_BLKP(oldptr)));
+#ifdef NEXT_FIT
+      // the rover must not be left inside the grown block
+      if(rover > (char *) oldptr && rover < NEXT_BLKP(oldptr))
+        rover = oldptr;
+#endif
+    }
+    split_tail(oldptr, asize); // shrink in place, or give back what is left over
+    return oldptr;
+  }
+
   newptr = malloc(size);
 
   if(!newptr){
     return 0;
   }
 
-  oldsize = GET_SIZE(HDRP(oldptr));
+  oldsize = GET_SIZE(HDRP(oldptr)) - WSIZE; // payload, no footer
   if(size < oldsize)
     oldsize = size;
   memcpy(newptr, oldptr, oldsize);
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include "contracts.h"
 
 #include "mm.h"
@@ -51,17 +52,34 @@
 #define WSIZE 1    // use 4-bytes word size as basic amount of size
 #define DSIZE 2
 #define CHUNKSIZE (1 << 10) // 1024 words
-#define OVERHEAD 2 // normal overhead in word(so it is 2 words)
+#define OVERHEAD 2 // prologue size in words
+#define MIN_BLOCK 2 // header + footer of a free block, in words
 
 #define FREE 1
 #define ALLOC 0
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+// segment tree over the heap
+#define SEGMENT_WORDS 128 // heap words summarized by one leaf
+#define SEGMENT_INIT 64 // first number of leaves
+#define NO_BLOCK 0 // offset 0 is the place holder, never a header
+
+// compile with -DNEXT_FIT to resume every search where the last one ended
+// instead of at the start of the heap
 
 static uint32_t *heap_listp;
+#ifdef NEXT_FIT
+static uint32_t *rover; // payload of the block the next search starts at
+#endif
+#ifndef NEXT_FIT
+static uint32_t *seg_tree; // largest free block per segment, leaves at seg_capacity
+static uint32_t *seg_first; // offset of the first header in each segment
+static uint32_t seg_capacity; // leaves, power of 2
+#endif
 static void *extend_heap(uint32_t words);
 static void *find_fit(uint32_t asize);
 static void place(void *bp, uint32_t asize);
+static void split_tail(void *bp, uint32_t asize);
 static void *coalesce(void *bp);
 
 
@@ -109,7 +127,7 @@ static inline uint32_t* block_hdrp(uint32_t* block) {
 
 // Return the size of the given block in multiples of the word size
 // 结果直接是 size based on word size, 不需要再除以WSIZE
-// 前2位: 0, a/f; 后30位: block size
+// 前2位: prev a/f, a/f; 后30位: block size
 
 // 参数：header / footer
 // 返回：size 
@@ -121,7 +139,8 @@ static inline unsigned int block_size(const uint32_t* block) {
     return (block[0] & 0x3FFFFFFF);
 }
 
-// Return the footer pointer of the pointer points to payload
+// Return the footer pointer of the pointer points to payload,
+// only free blocks have a footer
 
 // 参数：payload
 // 返回：footer
@@ -129,6 +148,7 @@ static inline uint32_t* block_ftrp(uint32_t* block) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
     REQUIRES(aligned(block));
+    REQUIRES(!(block_hdrp(block)[0] & 0x40000000));
 
     return block + block_size(block_hdrp(block)) - DSIZE;
 }
@@ -145,42 +165,57 @@ static inline int block_free(uint32_t* block) {
     return !(block[0] & 0x40000000);
 }
 
-// Mark the given block as free(1)/alloced(0) by marking the header and footer.
+// Return true if the previous block is free, false otherwise
+
+// 参数：header
+// 返回：free(1) / alloc(0)
+static inline int block_prev_free(const uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return !(block[0] & 0x80000000);
+}
+
+// Record in the header whether the previous block is free(1)/alloced(0)
+
+// 参数：header
+// 返回：空
+static inline void block_mark_prev(uint32_t* block, int free) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    block[0] = free ? block[0] & 0x7FFFFFFF : block[0] | 0x80000000;
+}
+
+// Mark the given block as free(1)/alloced(0) by marking the header, the
+// footer of a free block, and the prev bit of the next block's header.
 
 // 参数：header(footer同时完成)
 // 返回：空
 static inline void block_mark(uint32_t* block, int free) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
-    
-    if(block_size(block) == 0){
-      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
-      return;
-    } else {
-      unsigned int next = block_size(block) - 1; // ? 原: block_size(block) + 1
-      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
-      block[next] = block[0]; // 设置footer对应内容
+
+    block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
+    if(block_size(block) == 0) // epilogue or place holder
       return;
-    }
+
+    unsigned int next = block_size(block);
+    if(free)
+      block[next - 1] = block[0]; // 设置footer对应内容
+    block_mark_prev(block + next, free);
 }
 
-// set the block size to both header and footer
+// set the block size in the header, keeping only the prev bit,
+// block_mark writes the footer afterwards
 
-// 参数：header(footer同时完成)
+// 参数：header
 // 返回：空
 static inline void block_set_size(uint32_t* block, uint32_t size_in_words) {
   REQUIRES(block != NULL);
   REQUIRES(in_heap(block));
-  
-  if(size_in_words == 0) { // indicate the block do not have header or footer
-    block[0] = size_in_words;
-    return;
-  } else {
-    unsigned int next = size_in_words - 1;
-    block[0] = size_in_words;
-    block[next] = block[0]; // set footer
-    return;
-  }
+
+  block[0] = size_in_words | (block[0] & 0x80000000);
 }
 
 // Return a pointer to the memory malloc should return
@@ -195,13 +230,15 @@ static inline  uint32_t* block_mem(uint32_t* block) {
     return block + 1;
 }
 
-// Return the head pointer to the previous block
+// Return the head pointer to the previous block, which must be free
+// since only free blocks have a footer
 
 // 参数：header
 // 返回：header
 static inline uint32_t* block_prev(uint32_t* block) {
     REQUIRES(block != NULL);
     REQUIRES(in_heap(block));
+    REQUIRES(block_prev_free(block));
 
     return block - block_size(block - WSIZE); // 原: block_size(block - 1) - 1
 }
@@ -236,6 +273,125 @@ static inline uint32_t* block_next(uint32_t* block) {
 
 
 
+/*
+ *  Segment Functions
+ *  -----------------
+ *  The heap is cut into segments of SEGMENT_WORDS words. seg_first holds
+ *  the first block header inside every segment, and leaf i of seg_tree the
+ *  size of the largest free block whose header is inside segment i; every
+ *  inner node holds the larger of its two children, the root is node 1.
+ *  find_fit walks down to the first segment with a fit and only looks at
+ *  the blocks of that one, which still gives address ordered first fit.
+ *  Offsets count words from mem_heap_lo.
+ *  A next fit search starts at the rover instead, so -DNEXT_FIT builds
+ *  keep no segments and the calls below compile to nothing.
+ */
+
+#ifndef NEXT_FIT
+// Return the segment holding header hdr
+static inline uint32_t seg_of(const uint32_t* hdr) {
+    return (hdr - (uint32_t *) mem_heap_lo()) / SEGMENT_WORDS;
+}
+
+// Return the header at offset
+static inline uint32_t* seg_header(uint32_t offset) {
+    return (uint32_t *) mem_heap_lo() + offset;
+}
+
+// make room for segments [0, nsegs), one mapping holds the tree and
+// seg_first; return -1 if it cannot grow
+static int seg_grow(uint32_t nsegs) {
+    uint32_t capacity = seg_capacity ? seg_capacity : SEGMENT_INIT;
+    uint32_t *tree;
+
+    if(nsegs <= seg_capacity)
+      return 0;
+    while(capacity < nsegs)
+      capacity *= 2;
+    tree = mmap(NULL, capacity * 3 * sizeof(uint32_t), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(tree == MAP_FAILED)
+      return -1;
+
+    if(seg_capacity != 0){
+      memcpy(tree + capacity, seg_tree + seg_capacity, seg_capacity * sizeof(uint32_t));
+      memcpy(tree + 2 * capacity, seg_first, seg_capacity * sizeof(uint32_t));
+      munmap(seg_tree, seg_capacity * 3 * sizeof(uint32_t));
+    }
+    for(uint32_t i = capacity - 1; i > 0; i--)
+      tree[i] = MAX(tree[2 * i], tree[2 * i + 1]);
+
+    seg_tree = tree;
+    seg_first = tree + 2 * capacity;
+    seg_capacity = capacity;
+    return 0;
+}
+
+// a block header was written at hdr
+static inline void seg_add_header(uint32_t* hdr) {
+    uint32_t s = seg_of(hdr);
+    uint32_t offset = hdr - (uint32_t *) mem_heap_lo();
+
+    if(seg_first[s] == NO_BLOCK || offset < seg_first[s])
+      seg_first[s] = offset;
+}
+
+// the block at hdr was merged into the one in front of it, which is now
+// followed by the header next
+static inline void seg_remove_header(uint32_t* hdr, uint32_t* next) {
+    uint32_t s = seg_of(hdr);
+
+    if(seg_first[s] == (uint32_t) (hdr - (uint32_t *) mem_heap_lo()))
+      seg_first[s] = seg_of(next) == s ? (uint32_t) (next - (uint32_t *) mem_heap_lo()) :
+                                         NO_BLOCK;
+}
+
+// recompute the largest free block of segment s and pass it up the tree
+static void seg_update(uint32_t s) {
+    uint32_t largest = 0;
+    uint32_t i = seg_capacity + s;
+
+    if(seg_first[s] != NO_BLOCK){
+      for(uint32_t *hdr = seg_header(seg_first[s]);
+          seg_of(hdr) == s && block_size(hdr) > 0; hdr = block_next(hdr)){
+        if(block_free(hdr) && block_size(hdr) > largest)
+          largest = block_size(hdr);
+      }
+    }
+
+    seg_tree[i] = largest;
+    for(; i > 1; i /= 2){ // stop as soon as a parent does not change
+      uint32_t up = MAX(seg_tree[i], seg_tree[i ^ 1]);
+      if(seg_tree[i / 2] == up)
+        break;
+      seg_tree[i / 2] = up;
+    }
+}
+
+// Return the first free block of at least asize words, NULL if none
+static uint32_t* seg_first_fit(uint32_t asize) {
+    uint32_t i = 1;
+    uint32_t *hdr;
+
+    if(seg_tree[1] < asize)
+      return NULL;
+    while(i < seg_capacity) // the left child if it has a fit, else the right one
+      i = seg_tree[2 * i] >= asize ? 2 * i : 2 * i + 1;
+
+    // the segment has a fit, so the walk ends inside it
+    for(hdr = seg_header(seg_first[i - seg_capacity]); ; hdr = block_next(hdr)){
+      if(block_free(hdr) && asize <= block_size(hdr))
+        return block_mem(hdr);
+    }
+}
+#else
+#define seg_grow(...) 0
+#define seg_add_header(...)
+#define seg_remove_header(...)
+#define seg_update(...)
+#endif
+
+
 /*
  *  Malloc Implementation
  *  ---------------------
@@ -250,11 +406,13 @@ int mm_init(void) {
   if((heap_listp = mem_sbrk(4 * WSIZE * 4)) == NULL) // adjust words to bytes
     return -1;
   
+  block_mark_prev(heap_listp, ALLOC);
+  block_mark_prev(heap_listp + WSIZE, ALLOC);
   block_set_size(heap_listp, 0); // set first block for place holder
   block_mark(heap_listp, FREE);
   
   block_set_size(heap_listp + WSIZE, OVERHEAD); // set prologue block for 1st alloc block
-  block_mark(heap_listp + WSIZE, ALLOC);
+  block_mark(heap_listp + WSIZE, ALLOC); // also marks the epilogue's prev bit
   //block_set_size(heap_listp + DSIZE, OVERHEAD);
   //block_mark(heap_listp + DSIZE, ALLOC);
 
@@ -267,6 +425,20 @@ int mm_init(void) {
   PUT(heap_listp + WSIZE + DSIZE, PACK(0, 1));
   */
   heap_listp += DSIZE;
+#ifdef NEXT_FIT
+  rover = heap_listp;
+#endif
+
+#ifndef NEXT_FIT
+  if(seg_capacity != 0){ // summary of the previous heap
+    munmap(seg_tree, seg_capacity * 3 * sizeof(uint32_t));
+    seg_capacity = 0;
+  }
+#endif
+  if(seg_grow(1) < 0)
+    return -1;
+  seg_add_header(block_hdrp(heap_listp)); // prologue
+  seg_add_header(heap_listp + WSIZE); // epilogue
 
   if(extend_heap(CHUNKSIZE) == NULL)
     return -1;
@@ -281,17 +453,22 @@ static void *extend_heap(uint32_t words){
   uint32_t size;
   
   size = (words % 2) ? ((words + 1) * 4) : (words * 4); // convert to bytes
+  // the new epilogue goes to the last word of the grown heap
+  if(seg_grow(seg_of((uint32_t *) ((char *) mem_heap_hi() + 1 + size) - WSIZE) + 1) < 0)
+    return NULL;
   if((long)(bp = mem_sbrk(size)) < 0)  // use long for 64-bits machine!
     return NULL;
   
+  // the old epilogue becomes the header and keeps its prev bit
   block_set_size(block_hdrp(bp), size / 4); // bp is not the header, but the payload pointer
-  block_mark(block_hdrp(bp), FREE);
+  block_mark(block_hdrp(bp), FREE); // footer and the epilogue's prev bit
   
   //block_set_size(block_ftrp(bp), size / 4);
   //block_mark(block_ftrp(bp), FREE);
 
   block_set_size(block_next(block_hdrp(bp)), 0);
   block_mark(block_next(block_hdrp(bp)), ALLOC);
+  seg_add_header(block_next(block_hdrp(bp))); // the old one is bp's header now
   // PUT(HDRP(bp), PACK(size, 0));
   // PUT(FTRP(bp), PACK(size, 0));
   //PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // epilogue block
@@ -299,6 +476,14 @@ static void *extend_heap(uint32_t words){
   return coalesce(bp);
 }
 
+// Return the block size in words for a request of size bytes; allocated
+// blocks only pay for the header, a free block needs room for its footer
+static inline size_t adjust_size(size_t size){
+  size_t asize = 8 * ((size + 4 + (8 - 1)) / 8);
+
+  return MAX(asize / 4, MIN_BLOCK); // convert bytes to words
+}
+
 /*
  * malloc
  */
@@ -312,12 +497,7 @@ void *malloc (size_t size) {
   if(size <= 0)
     return NULL;
 
-  if(size <= 8) // set actual size
-    asize = 8 + 8;
-  else
-    asize = 8 * ((size + 8 + (8 - 1)) / 8);
-
-  asize = asize / 4; // convert bytes to words
+  asize = adjust_size(size);
 
   if((bp = find_fit(asize)) != NULL){ // find fit place
     place(bp, asize);
@@ -337,14 +517,25 @@ void *malloc (size_t size) {
 
 static void *find_fit(uint32_t asize){
   //printf("enter find_fit\n");
-  void *bp;
-  
-  for(bp = heap_listp; (in_heap(bp)) && (block_size(block_hdrp(bp)) > 0); 
-                        bp = block_mem(block_next(block_hdrp(bp)))){ // convert to payload
-    if(block_free(block_hdrp(bp)) && (asize <= block_size(block_hdrp(bp)))){
-      return bp;
+#ifdef NEXT_FIT
+  uint32_t *oldrover = rover;
+
+  // from the rover to the end of the heap, then from the start up to it
+  for(; (in_heap(rover)) && (block_size(block_hdrp(rover)) > 0);
+        rover = block_mem(block_next(block_hdrp(rover)))){ // convert to payload
+    if(block_free(block_hdrp(rover)) && (asize <= block_size(block_hdrp(rover)))){
+      return rover;
+    }
+  }
+  for(rover = heap_listp; rover < oldrover;
+        rover = block_mem(block_next(block_hdrp(rover)))){
+    if(block_free(block_hdrp(rover)) && (asize <= block_size(block_hdrp(rover)))){
+      return rover;
     }
   }
+#else
+  return seg_first_fit(asize); // skips segments without a fit
+#endif
   /*
   for(bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)){
     if(!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))){
@@ -360,9 +551,10 @@ static void place(void *bp, uint32_t asize){
   //printf("enter place\n");
   uint32_t csize = block_size(block_hdrp(bp));
 
-  if((csize - asize) >= (DSIZE + OVERHEAD)){
+  if((csize - asize) >= MIN_BLOCK){
     block_set_size(block_hdrp(bp), asize);
     block_mark(block_hdrp(bp), ALLOC);
+    seg_update(seg_of(block_hdrp(bp)));
 
     //block_set_size(block_ftrp(bp), asize);
     //block_mark(block_ftrp(bp), ALLOC);
@@ -371,6 +563,8 @@ static void place(void *bp, uint32_t asize){
     
     block_set_size(block_hdrp(bp), csize - asize);
     block_mark(block_hdrp(bp), FREE);
+    seg_add_header(block_hdrp(bp));
+    seg_update(seg_of(block_hdrp(bp)));
     return;
     //block_set_size(block_ftrp(bp), csize - asize);
     //block_mark(block_ftrp(bp), FREE);
@@ -383,6 +577,7 @@ static void place(void *bp, uint32_t asize){
   else{
     block_set_size(block_hdrp(bp), csize);
     block_mark(block_hdrp(bp), ALLOC);
+    seg_update(seg_of(block_hdrp(bp)));
     return;
     //block_set_size(block_ftrp(bp), csize);
     //block_mark(block_ftrp(bp), ALLOC);
@@ -392,6 +587,26 @@ static void place(void *bp, uint32_t asize){
   //printf("exit place\n");
 }
 
+// cut allocated block bp down to asize words and free the tail, as long as
+// the tail is big enough to be a block of its own
+static void split_tail(void *bp, uint32_t asize){
+  uint32_t csize = block_size(block_hdrp(bp));
+
+  if((csize - asize) < MIN_BLOCK) // do not split the block
+    return;
+
+  block_set_size(block_hdrp(bp), asize);
+  block_mark(block_hdrp(bp), ALLOC);
+
+  bp = block_mem(block_next(block_hdrp(bp))); // bp points to the tail's payload
+
+  block_set_size(block_hdrp(bp), csize - asize);
+  block_mark(block_hdrp(bp), FREE);
+  seg_add_header(block_hdrp(bp));
+
+  coalesce(bp); // the tail may touch a free next block, updates the segments
+}
+
 
 /*
  * free
@@ -420,7 +635,11 @@ void free(void *ptr) {
 
 static void *coalesce(void *bp){
   //printf("enter coalesce\n");
-  int prev_alloc = block_free(block_prev(block_hdrp(bp)));
+#ifndef NEXT_FIT
+  uint32_t *hdr = block_hdrp(bp);
+  uint32_t *next = block_next(hdr);
+#endif
+  int prev_alloc = block_prev_free(block_hdrp(bp));
   //uint32_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
   //printf("prev_alloc = %x\n", prev_alloc);
   int next_alloc = block_free(block_next(block_hdrp(bp)));
@@ -431,8 +650,6 @@ static void *coalesce(void *bp){
   //printf("size = %x\n", size);
 
   if(!prev_alloc && !next_alloc){ // no need to coalesce
-    //printf("exit coalesce\n");
-    return bp;
   }
 
   else if(!prev_alloc && next_alloc){ // merge next
@@ -445,8 +662,6 @@ static void *coalesce(void *bp){
     //block_mark(block_ftrp(bp), FREE);
     //PUT(HDRP(bp), PACK(size, 0));
     //PUT(FTRP(bp), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return (bp);
   }
 
   else if(prev_alloc && !next_alloc){ // merge prev
@@ -459,8 +674,7 @@ static void *coalesce(void *bp){
     block_mark(block_prev(block_hdrp(bp)), FREE);
     //PUT(FTRP(bp), PACK(size, 0));
     //PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return block_mem(block_prev(block_hdrp(bp)));
+    bp = block_mem(block_prev(block_hdrp(bp)));
     //return (PREV_BLKP(bp));
   }
 
@@ -475,10 +689,30 @@ static void *coalesce(void *bp){
     //block_mark(block_next(block_hdrp(bp)), FREE);
     //PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
     //PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-    //printf("exit coalesce\n");
-    return block_mem(block_prev(block_hdrp(bp)));
+    bp = block_mem(block_prev(block_hdrp(bp)));
     //return (PREV_BLKP(bp));
   }
+
+#ifdef NEXT_FIT
+  // the rover must not be left inside the merged block
+  if(rover > (uint32_t *) bp && rover < block_mem(block_next(block_hdrp(bp))))
+    rover = bp;
+#endif
+
+#ifndef NEXT_FIT
+  // headers merged away, then the summaries of their segments and bp's
+  if(block_hdrp(bp) != hdr)
+    seg_remove_header(hdr, block_next(block_hdrp(bp)));
+  if(next_alloc)
+    seg_remove_header(next, block_next(block_hdrp(bp)));
+  seg_update(seg_of(hdr));
+  if(next_alloc && seg_of(next) != seg_of(hdr))
+    seg_update(seg_of(next));
+  if(seg_of(block_hdrp(bp)) != seg_of(hdr))
+    seg_update(seg_of(block_hdrp(bp)));
+#endif
+  //printf("exit coalesce\n");
+  return bp;
 }
 
 
@@ -488,6 +722,8 @@ static void *coalesce(void *bp){
 void *realloc(void *oldptr, size_t size) {
   //printf("enter realloc\n");
   size_t oldsize;
+  size_t asize;
+  size_t avail;
   void *newptr;
   checkheap(1);
   if(size == 0){
@@ -501,13 +737,49 @@ void *realloc(void *oldptr, size_t size) {
     return malloc(size);
   }
 
+  asize = adjust_size(size);
+
+  uint32_t *hdr = block_hdrp(oldptr);
+  uint32_t *next = block_next(hdr);
+  avail = block_size(hdr); // what oldptr can get without moving
+
+  if(block_free(next))
+    avail += block_size(next);
+
+  if(asize > avail &&
+    block_size(block_free(next) ? block_next(next) : next) == 0){
+    // oldptr is the last block, maybe followed by one free block: grow the
+    // heap, extend_heap merges the new space into a free block after oldptr
+    if(extend_heap(MAX(asize - avail, CHUNKSIZE)) == NULL)
+      return NULL;
+    next = block_next(hdr);
+    avail = block_size(hdr) + block_size(next);
+  }
+
+  if(asize <= avail){
+    if(avail > block_size(hdr)){ // take over the free next block
+      block_set_size(hdr, avail);
+      block_mark(hdr, ALLOC);
+#ifdef NEXT_FIT
+      // the rover must not be left inside the grown block
+      if(rover > (uint32_t *) oldptr && rover < block_mem(block_next(hdr)))
+        rover = oldptr;
+#endif
+      seg_remove_header(next, block_next(hdr));
+      seg_update(seg_of(next));
+    }
+    split_tail(oldptr, asize); // shrink in place, or give back what is left over
+    checkheap(1);
+    return oldptr;
+  }
+
   newptr = malloc(size);
 
   if(!newptr){
     return 0;
   }
   
-  oldsize = block_size(block_hdrp(oldptr));
+  oldsize = block_size(block_hdrp(oldptr)) - 1; // payload, no footer
   oldsize *= 4;
   //oldsize = GET_SIZE(HDRP(oldptr));
   if(size < oldsize) // convert words to bytes
@@ -536,6 +808,48 @@ void *calloc (size_t nmemb, size_t size) {
   return newptr;
 }
 
+#ifndef NEXT_FIT
+// check seg_first and seg_tree against the blocks of the heap
+static int check_segments(void) {
+    uint32_t *hdr = block_hdrp(heap_listp); // the prologue, the first header
+
+    for(uint32_t s = 0; s < seg_capacity; s++){
+      uint32_t first = NO_BLOCK;
+      uint32_t largest = 0;
+
+      // every header of segment s, up to and including the epilogue
+      while(hdr != NULL && seg_of(hdr) == s){
+        if(first == NO_BLOCK)
+          first = hdr - (uint32_t *) mem_heap_lo();
+        if(block_free(hdr) && block_size(hdr) > largest)
+          largest = block_size(hdr);
+        hdr = block_size(hdr) == 0 ? NULL : block_next(hdr);
+      }
+      if(seg_first[s] != first){
+        printf(" checkheap: seg_first does not point at the first header of segment %u\n", s);
+        return 1;
+      }
+      if(seg_tree[seg_capacity + s] != largest){
+        printf(" checkheap: seg_tree leaf does not match the largest free block of segment %u\n", s);
+        return 1;
+      }
+    }
+    if(hdr != NULL){
+      printf(" checkheap: heap is larger than the segment tree\n");
+      return 1;
+    }
+    for(uint32_t i = 1; i < seg_capacity; i++){
+      if(seg_tree[i] != MAX(seg_tree[2 * i], seg_tree[2 * i + 1])){
+        printf(" checkheap: seg_tree node is not the larger of its children\n");
+        return 1;
+      }
+    }
+    return 0;
+}
+#else
+#define check_segments() 0
+#endif
+
 // Returns 0 if no errors were found, otherwise returns the error
 int mm_checkheap(int verbose) {
     if(verbose == 1){ // if verbose == 1, then check heap　
@@ -549,14 +863,6 @@ int mm_checkheap(int verbose) {
           printf(" checkheap: prologue header free/alloc bit error\n");
           return 1;
         }
-        if(block_size(heap_listp) != 2){
-          printf(" checkheap: prologue footer size error\n");
-          return 1;
-        }
-        if(block_free(heap_listp) != 0){
-          printf(" checkheap: prologue footer free/alloc bit error\n");
-          return 1;
-        }
 
         // check heap boundary and epilogue block
         if(block_size((uint32_t *) mem_heap_lo()) != 0){
@@ -578,18 +884,22 @@ int mm_checkheap(int verbose) {
         
         // check each block's address alignment
         /* check each block's header and footer: minimum size, alignment, 
-           bit consistency, header and footer matching, 
-           no two consecutive free blocks */
+           bit consistency, header and footer matching of free blocks,
+           prev bit matching the previous block, no two consecutive free blocks */
         uint32_t *ptr = heap_listp;
         uint32_t free_block_flag = 0;
+#ifdef NEXT_FIT
+        int rover_found = 0; // the rover points at one of the blocks
+#endif
 
         while(1){
             if(aligned(ptr) != 1){
               printf(" checkheap: payload block alignment problem\n");
               return 1;
             }
-            if(aligned(block_ftrp(ptr)) != 1){
-              printf(" checkheap: footer block alignment problem\n");
+            if(block_prev_free(block_next(block_hdrp(ptr))) !=
+               block_free(block_hdrp(ptr))){
+              printf(" checkheap: prev bit in next header does not match this block\n");
               return 1;
             }
             if(ptr == heap_listp){
@@ -598,20 +908,31 @@ int mm_checkheap(int verbose) {
                 return 1;
               }
             }else{
-              if(block_size(block_hdrp(ptr)) < 4){
-                printf(" checkheap: size in header less than 4-words-minimum\n");
+              if(block_size(block_hdrp(ptr)) < MIN_BLOCK){
+                printf(" checkheap: size in header less than 2-words-minimum\n");
                 return 1;
               }
             }
-            if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
-              printf(" checkheap: size in header not equal to size in footer\n");
-              return 1;
-            }
-            if(block_free(block_hdrp(ptr)) != block_free(block_ftrp(ptr))){
-              printf(" checkheap: free/alloc bit in header not equal to mafree/alloc bit in footer\n");
-              return 1;
+            if(block_free(block_hdrp(ptr))){ // only free blocks have a footer
+              if(aligned(block_ftrp(ptr)) != 1){
+                printf(" checkheap: footer block alignment problem\n");
+                return 1;
+              }
+              if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
+                printf(" checkheap: size in header not equal to size in footer\n");
+                return 1;
+              }
+              if(block_free(block_ftrp(ptr)) != 1){
+                printf(" checkheap: free/alloc bit in header not equal to mafree/alloc bit in footer\n");
+                return 1;
+              }
             }
 
+#ifdef NEXT_FIT
+            if(ptr == rover)
+              rover_found = 1;
+#endif
+
             // check no two consecutive free blocks
             if(free_block_flag == 0 && block_free(block_hdrp(ptr)) == 1){
               // first time free blocks
@@ -629,7 +950,13 @@ int mm_checkheap(int verbose) {
               block_free(block_next(block_hdrp(ptr))) == 0){ 
               // almost ??? reach epilogue ???
               if(block_next(block_hdrp(ptr)) == (uint32_t *)((char *)mem_heap_hi() - 3)){
-                return 0;
+#ifdef NEXT_FIT
+                if(!rover_found){
+                  printf(" checkheap: rover does not point at a block\n");
+                  return 1;
+                }
+#endif
+                return check_segments();
               }else{
                 printf(" checkheap: fatal error: this should be a new header, but its value shows that it is an epilogue\n");
                 return 1;
@@ -0,0 +1,513 @@
+/*
+ *  Name: Yijie Ma
+ *  AndrewID: yijiem
+ *
+ *  Out-of-band metadata allocator.
+ *
+ *  The heap holds payloads only. It is cut into 8-byte granules, and two
+ *  bitmaps outside of it, one bit per granule, describe every block:
+ *  free_map has the bit of each granule of a free block set, start_map the
+ *  bit of the first granule of each allocated block. An allocated block
+ *  runs up to the next granule that is free or starts a block, so blocks
+ *  need no header, no footer and no minimum size, and a free block is just
+ *  a run of set bits in free_map. Two free neighbours are one run, so
+ *  coalescing is nothing more than setting the bits of the freed block.
+ *
+ *  find_fit is address ordered first fit over free_map: it skips words
+ *  without a free granule several at a time with AVX2 or SSE2 when the
+ *  compiler targets them, and measures runs of set bits inside the other
+ *  words with count-trailing-zeros. malloc, free, realloc and mm_checkheap
+ *  only ever read and write the bitmaps, never the heap, so a freed
+ *  payload is not touched again until it is handed out again.
+ *
+ *  The bitmaps are reserved for MAX_HEAP_BYTES of heap with MAP_NORESERVE,
+ *  so only the part covering the heap so far ever gets memory.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "contracts.h"
+
+#include "mm.h"
+#include "memlib.h"
+
+
+// Create aliases for driver tests
+// DO NOT CHANGE THE FOLLOWING!
+#ifdef DRIVER
+#define malloc mm_malloc
+#define free mm_free
+#define realloc mm_realloc
+#define calloc mm_calloc
+#endif
+
+/*
+ *  Logging Functions
+ *  -----------------
+ *  - dbg_printf acts like printf, but will not be run in a release build.
+ *  - checkheap acts like mm_checkheap, but prints the line it failed on and
+ *    exits if it fails.
+ */
+
+#ifndef NDEBUG
+#define dbg_printf(...) printf(__VA_ARGS__)
+#define checkheap(verbose) do {if (mm_checkheap(verbose)) {  \
+                             printf("Checkheap failed on line %d\n", __LINE__);\
+                             exit(-1);  \
+                        }}while(0)
+#else
+#define dbg_printf(...)
+#define checkheap(...)
+#endif
+
+
+/*
+ *  some useful macro
+ */
+#define GRANULE 8 // bytes, every payload is aligned to it
+#define CHUNKSIZE (1 << 9) // granules the heap grows by at least(4KB)
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+// override with -DMAX_HEAP_BYTES=<bytes>
+#ifndef MAX_HEAP_BYTES
+#define MAX_HEAP_BYTES (1ULL << 32) // heap the bitmaps are reserved for
+#endif
+#define MAP_WORDS (MAX_HEAP_BYTES / GRANULE / 64) // 64-bit words per bitmap
+
+#define NO_FIT ((uint64_t) -1)
+
+static char *heap_base; // granule 0
+static uint64_t heap_granules; // granules in the heap
+static uint64_t *free_map; // bit g set <=> granule g is in a free block
+static uint64_t *start_map; // bit g set <=> an allocated block starts at granule g
+static uint64_t free_hint; // words of free_map below this one have no bit set
+
+static int extend_heap(uint64_t granules);
+static uint64_t find_fit(uint64_t granules);
+static void place(uint64_t g, uint64_t granules);
+
+
+/*
+ *  Helper functions
+ *  ----------------
+ */
+
+// Align p to a multiple of w bytes
+static inline void* align(const void const* p, unsigned char w) {
+    return (void*)(((uintptr_t)(p) + (w-1)) & ~(w-1));
+}
+
+// Check if the given pointer is 8-byte aligned
+static inline int aligned(const void const* p) {
+    return align(p, 8) == p;
+}
+
+// Return whether the pointer is in the heap.
+static inline int in_heap(const void* p) {
+    return p <= mem_heap_hi() && p >= (void *) heap_base;
+}
+
+
+/*
+ *  Granule Functions
+ *  -----------------
+ *  Granule g is the 8 bytes at heap_base + 8 * g, its bits are bit g % 64
+ *  of word g / 64 of each bitmap. Bits past heap_granules are always 0.
+ */
+
+// Return the granule payload bp starts at
+static inline uint64_t granule_of(const void* bp) {
+    REQUIRES(in_heap(bp));
+    REQUIRES(aligned(bp));
+
+    return ((char *) bp - heap_base) / GRANULE;
+}
+
+// Return the payload starting at granule g
+static inline void* granule_mem(uint64_t g) {
+    REQUIRES(g < heap_granules);
+
+    return heap_base + g * GRANULE;
+}
+
+// Return the granules needed for size bytes
+static inline uint64_t granules(size_t size) {
+    return (size + GRANULE - 1) / GRANULE;
+}
+
+static inline int bit_test(const uint64_t* map, uint64_t g) {
+    return map[g / 64] >> (g % 64) & 1;
+}
+
+static inline void bit_set(uint64_t* map, uint64_t g) {
+    map[g / 64] |= 1ULL << (g % 64);
+}
+
+static inline void bit_clear(uint64_t* map, uint64_t g) {
+    map[g / 64] &= ~(1ULL << (g % 64));
+}
+
+// set(1) or clear(0) the bits of granules [from, to)
+static void bits_fill(uint64_t* map, uint64_t from, uint64_t to, int value) {
+    while(from < to){
+      unsigned int lo = from % 64;
+      uint64_t n = MIN(64 - lo, to - from);
+      uint64_t mask = n == 64 ? ~0ULL : ((1ULL << n) - 1) << lo;
+
+      if(value)
+        map[from / 64] |= mask;
+      else
+        map[from / 64] &= ~mask;
+      from += n;
+    }
+}
+
+// Return the first word at or after word i, and before last, that has a
+// free granule; last if there is none
+static inline uint64_t skip_allocated(uint64_t i, uint64_t last) {
+#if defined(__AVX2__)
+    for(; i + 4 <= last; i += 4){
+      __m256i v = _mm256_loadu_si256((const __m256i *) (free_map + i));
+      if(!_mm256_testz_si256(v, v))
+        break;
+    }
+#elif defined(__SSE2__)
+    for(; i + 2 <= last; i += 2){
+      __m128i v = _mm_loadu_si128((const __m128i *) (free_map + i));
+      if(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xFFFF)
+        break;
+    }
+#endif
+    while(i < last && free_map[i] == 0)
+      i++;
+    return i;
+}
+
+// Return the granule after the allocated block starting at g: the next
+// one that is free or starts a block, or the end of the heap
+static uint64_t block_end(uint64_t g) {
+    uint64_t last = (heap_granules + 63) / 64;
+    uint64_t i = (g + 1) / 64;
+    uint64_t w;
+
+    REQUIRES(bit_test(start_map, g));
+
+    if(g + 1 >= heap_granules)
+      return heap_granules;
+    w = (free_map[i] | start_map[i]) & (~0ULL << ((g + 1) % 64));
+    while(w == 0){
+      if(++i == last)
+        return heap_granules;
+      w = free_map[i] | start_map[i];
+    }
+    return i * 64 + __builtin_ctzll(w);
+}
+
+// Return how many granules from g on are free, counting at most limit
+static uint64_t free_run(uint64_t g, uint64_t limit) {
+    uint64_t run = 0;
+
+    while(run < limit && g + run < heap_granules){
+      unsigned int b = (g + run) % 64;
+      uint64_t rest = ~(free_map[(g + run) / 64] >> b); // 0 bits are free ones
+      unsigned int ones = rest == 0 ? 64 : __builtin_ctzll(rest);
+
+      run += ones;
+      if(ones < 64 - b) // the run ends inside this word
+        break;
+    }
+    return MIN(run, limit);
+}
+
+// Return the number of free granules at the top of the heap
+static uint64_t free_top(void) {
+    uint64_t g = heap_granules;
+
+    while(g > 0){
+      unsigned int top = (g - 1) % 64; // bit of granule g - 1
+      uint64_t below = ~free_map[(g - 1) / 64] << (63 - top);
+
+      if(below != 0)
+        return heap_granules - (g - __builtin_clzll(below));
+      g -= top + 1; // granules up to g - 1 in this word are all free
+    }
+    return heap_granules;
+}
+
+
+/*
+ *  Malloc Implementation
+ *  ---------------------
+ *  The following functions deal with the user-facing malloc implementation.
+ */
+
+/*
+ * Initialize: return -1 on error, 0 on success.
+ */
+int mm_init(void) {
+  char *brk;
+
+  if(free_map == NULL){
+    uint64_t *maps = mmap(NULL, 2 * MAP_WORDS * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(maps == MAP_FAILED)
+      return -1;
+    free_map = maps;
+    start_map = maps + MAP_WORDS;
+  }else{ // bits of the previous heap
+    memset(free_map, 0, (heap_granules + 63) / 64 * sizeof(uint64_t));
+    memset(start_map, 0, (heap_granules + 63) / 64 * sizeof(uint64_t));
+  }
+
+  // granule 0 is the first 8-byte aligned address of the heap
+  if((long)(brk = mem_sbrk(0)) < 0)
+    return -1;
+  heap_base = align(brk, GRANULE);
+  if(heap_base != brk && (long) mem_sbrk(heap_base - brk) < 0)
+    return -1;
+  heap_granules = 0;
+  free_hint = 0;
+
+  if(extend_heap(CHUNKSIZE) < 0)
+    return -1;
+  checkheap(1);
+  return 0;
+}
+
+// grow the heap by n granules, free ones; return -1 on error, 0 on success
+static int extend_heap(uint64_t n){
+  if(heap_granules + n > MAX_HEAP_BYTES / GRANULE || n * GRANULE > 0x7FFFFFFF)
+    return -1;
+  if((long) mem_sbrk(n * GRANULE) < 0)  // use long for 64-bits machine!
+    return -1;
+
+  bits_fill(free_map, heap_granules, heap_granules + n, 1); // joins a free top
+  if(heap_granules / 64 < free_hint)
+    free_hint = heap_granules / 64;
+  heap_granules += n;
+  return 0;
+}
+
+/*
+ * malloc
+ */
+void *malloc (size_t size) {
+  checkheap(1);  // Let's make sure the heap is ok!
+  uint64_t n = granules(size);
+  uint64_t g;
+
+  if(size == 0)
+    return NULL;
+
+  if((g = find_fit(n)) == NO_FIT){
+    // grow the heap, the new granules join the free run at its top
+    uint64_t top = free_top();
+
+    g = heap_granules - top;
+    if(extend_heap(MAX(n - top, CHUNKSIZE)) < 0)
+      return NULL;
+  }
+  place(g, n);
+  checkheap(1);
+  return granule_mem(g);
+}
+
+// find fit: the first run of at least n free granules, NO_FIT if none;
+// words without a free granule are skipped before any bit is looked at
+static uint64_t find_fit(uint64_t n){
+  uint64_t last = (heap_granules + 63) / 64;
+  uint64_t i = skip_allocated(free_hint, last);
+  uint64_t run = 0, run_start = 0;
+
+  free_hint = i; // nothing free in front of it
+
+  for(; i < last; i++){
+    uint64_t w = free_map[i];
+    unsigned int bit = 0;
+
+    if(run == 0 && w == 0){
+      i = skip_allocated(i, last) - 1;
+      continue;
+    }
+    if(w == ~0ULL){ // all free, the run goes on
+      if(run == 0)
+        run_start = i * 64;
+      run += 64;
+      if(run >= n)
+        return run_start;
+      continue;
+    }
+
+    while(bit < 64){
+      uint64_t rest = w >> bit;
+      unsigned int ones;
+
+      if(run == 0){ // look for the next run in this word
+        if(rest == 0)
+          break;
+        bit += __builtin_ctzll(rest);
+        run_start = i * 64 + bit;
+        rest = w >> bit;
+      }
+      ones = ~rest == 0 ? 64 - bit : (unsigned int) __builtin_ctzll(~rest);
+      run += ones;
+      bit += ones;
+      if(run >= n)
+        return run_start;
+      if(bit < 64) // the run ended inside this word
+        run = 0;
+    }
+  }
+  return NO_FIT;
+}
+
+// allocate n granules at the start of the free run at g; the rest of the
+// run stays free and ends the new block
+static void place(uint64_t g, uint64_t n){
+  REQUIRES(free_run(g, n) == n);
+
+  bits_fill(free_map, g, g + n, 0);
+  bit_set(start_map, g);
+}
+
+
+/*
+ * free - the block's granules become free and join the free runs around
+ * them, the payload itself is never written
+ */
+void free (void *ptr) {
+  uint64_t g;
+
+  if((long)ptr <= 0)
+    return;
+  checkheap(1);
+
+  g = granule_of(ptr);
+  bits_fill(free_map, g, block_end(g), 1);
+  bit_clear(start_map, g);
+  if(g / 64 < free_hint)
+    free_hint = g / 64;
+  checkheap(1);
+}
+
+
+/*
+ * realloc - shrink in place, grow in place into the free run behind the
+ * block or the top of the heap, move the block only otherwise
+ */
+void *realloc(void *oldptr, size_t size) {
+  uint64_t g, end, n, avail;
+  void *newptr;
+
+  if(size == 0){
+    free(oldptr);
+    return NULL; // should return NULL
+  }
+
+  if(oldptr == NULL){
+    return malloc(size);
+  }
+  checkheap(1);
+
+  g = granule_of(oldptr);
+  end = block_end(g);
+  n = granules(size);
+
+  if(g + n <= end){ // the tail becomes free
+    bits_fill(free_map, g + n, end, 1);
+    if((g + n) / 64 < free_hint)
+      free_hint = (g + n) / 64;
+    checkheap(1);
+    return oldptr;
+  }
+
+  avail = end - g + free_run(end, g + n - end);
+  if(avail < n && g + avail == heap_granules){
+    // the last block, maybe followed by a free top: grow the heap
+    if(extend_heap(MAX(g + n - heap_granules, CHUNKSIZE)) < 0)
+      return NULL;
+    avail = n;
+  }
+  if(avail >= n){ // take the granules behind it
+    bits_fill(free_map, end, g + n, 0);
+    checkheap(1);
+    return oldptr;
+  }
+
+  if((newptr = malloc(size)) == NULL)
+    return NULL;
+  memcpy(newptr, oldptr, (end - g) * GRANULE); // smaller than size
+  free(oldptr);
+  return newptr;
+}
+
+/*
+ * calloc - you may want to look at mm-naive.c
+ */
+void *calloc (size_t nmemb, size_t size) {
+  size_t bytes = nmemb * size;
+  void *newptr;
+
+  newptr = malloc(bytes);
+  if(newptr == NULL)
+    return NULL;
+  memset(newptr, 0, bytes);
+  return newptr;
+}
+
+// Returns 0 if no errors were found, otherwise returns the error
+int mm_checkheap(int verbose) {
+    if(verbose == 1){ // if verbose == 1, then check heap
+        uint64_t last = (heap_granules + 63) / 64;
+
+        // check the heap bounds
+        if(aligned(heap_base) != 1){
+          printf(" checkheap: heap_base alignment problem\n");
+          return 1;
+        }
+        if(heap_base + heap_granules * GRANULE != (char *) mem_heap_hi() + 1){
+          printf(" checkheap: heap_granules does not match the heap size\n");
+          return 1;
+        }
+
+        // check the bitmaps a word at a time
+        for(uint64_t i = 0; i < last + 1 && i < MAP_WORDS; i++){
+          uint64_t live = i < last ? ~0ULL : 0; // granules inside the heap
+          uint64_t prev_free; // bit g set <=> granule g - 1 is free or g is 0
+
+          if(i == last - 1 && heap_granules % 64 != 0)
+            live = (1ULL << (heap_granules % 64)) - 1;
+
+          if((free_map[i] | start_map[i]) & ~live){
+            printf(" checkheap: bit set past the end of the heap\n");
+            return 1;
+          }
+          if(free_map[i] & start_map[i]){
+            printf(" checkheap: block starts at a free granule\n");
+            return 1;
+          }
+          if(i < free_hint && free_map[i] != 0){
+            printf(" checkheap: free granule in front of free_hint\n");
+            return 1;
+          }
+
+          // an allocated granule right after a free one must start a block
+          prev_free = free_map[i] << 1 | (i == 0 ? 1 : free_map[i - 1] >> 63);
+          if(~free_map[i] & live & prev_free & ~start_map[i]){
+            printf(" checkheap: allocated granule belongs to no block\n");
+            return 1;
+          }
+        }
+    }
+    return 0;
+}
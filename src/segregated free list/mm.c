@@ -0,0 +1,2576 @@
+/*
+ *  Name: Yijie Ma
+ *  AndrewID: yijiem
+ *
+ *  Segregated free list allocator.
+ *
+ *  Blocks have a 4-byte header with the size in words; bit 31 tells
+ *  whether the previous block is allocated, so only free blocks carry a
+ *  footer. Free blocks link through 32-bit word offsets from the heap base,
+ *  which makes the minimum block 16 bytes. Blocks below EXACT_CLASS_LIMIT
+ *  words get one list per size, larger ones four lists per power of two,
+ *  and a bitmap of non-empty lists lets find_fit skip empty ones. Blocks of
+ *  TREE_THRESHOLD words or more go to a treap keyed by size instead, for an
+ *  exact best fit in O(log n).
+ *
+ *  malloc tries, in order: the calling thread's cache, a slab run for
+ *  SLAB_MAX bytes or less, a mapping of its own for MMAP_THRESHOLD bytes or
+ *  more, the quick bin of the exact size, then the lists and the tree. The
+ *  heap grows by a step that doubles while mallocs outpace frees. A large
+ *  free top is trimmed, and tree blocks that stay free long enough have
+ *  their pages purged. -DHUGE_PAGES keeps every heap on HUGE_PAGE_SIZE
+ *  boundaries.
+ *
+ *  Each of these structures belongs to an arena with its own mutex. The
+ *  main arena is the mem_sbrk heap. Up to one more per CPU lives in an
+ *  ARENA_SIZE slot of one reserved region. Threads get arenas round robin.
+ *  free finds a block's arena from its address, and a block freed from
+ *  another thread goes onto that arena's lock-free remote stack.
+ */
+
+#define _GNU_SOURCE // mremap
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "contracts.h"
+
+#include "mm.h"
+#include "mm_ext.h"
+#include "memlib.h"
+
+
+// Create aliases for driver tests
+// DO NOT CHANGE THE FOLLOWING!
+#ifdef DRIVER
+#define malloc mm_malloc
+#define free mm_free
+#define realloc mm_realloc
+#define calloc mm_calloc
+#endif
+
+/*
+ *  Logging Functions
+ *  -----------------
+ *  - dbg_printf acts like printf, but will not be run in a release build.
+ *  - checkheap acts like mm_checkheap, but prints the line it failed on and
+ *    exits if it fails.
+ */
+
+#ifndef NDEBUG
+#define dbg_printf(...) printf(__VA_ARGS__)
+#define checkheap(verbose) do {if (mm_checkheap(verbose)) {  \
+                             printf("Checkheap failed on line %d\n", __LINE__);\
+                             exit(-1);  \
+                        }}while(0)
+#else
+#define dbg_printf(...)
+#define checkheap(...)
+#endif
+
+
+/*
+ *  some useful macro
+ */
+#define WSIZE 1    // use 4-bytes word size as basic amount of size
+#define DSIZE 2
+#define CHUNKSIZE (1 << 9) // 512 words
+#define OVERHEAD 2 // prologue size in words
+#define MIN_BLOCK 4 // header + prev + succ + footer of a free block, in words
+
+#define FREE 1
+#define ALLOC 0
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+#define END_OF_LIST 0 // offset 0 is the list head area, never a block
+
+// size classes
+#define EXACT_CLASS_SHIFT 6
+#define EXACT_CLASS_LIMIT (1 << EXACT_CLASS_SHIFT) // 64 words
+#define TREE_SHIFT 10
+#define TREE_THRESHOLD (1 << TREE_SHIFT) // 1024 words, larger blocks go to the tree
+#define NUM_CLASSES (EXACT_CLASS_LIMIT / 2 + (TREE_SHIFT - EXACT_CLASS_SHIFT) * 4)
+
+// large blocks, override with -DMMAP_THRESHOLD=<bytes>
+#ifndef MMAP_THRESHOLD
+#define MMAP_THRESHOLD (128 * 1024) // requests this big get their own mapping
+#endif
+#define MMAP_HEADER 8 // bytes in front of a mapped payload, holds the mapping length
+#define MAPPED_TABLE_INIT 64 // first capacity of the mapped block table
+
+// trimming, override with -DTRIM_THRESHOLD=<bytes> and -DTRIM_PAD=<bytes>
+#ifndef TRIM_THRESHOLD
+#define TRIM_THRESHOLD (128 * 1024) // free tops this big are given back
+#endif
+#ifndef TRIM_PAD
+#define TRIM_PAD (CHUNKSIZE * 4) // bytes kept free at the top by free
+#endif
+#define TRIM_STEP ((size_t) INT_MAX & ~7) // largest shrink one mem_sbrk can do
+
+// heap growth, override with -DGROW_MAX=<bytes>
+#ifndef GROW_MAX
+#define GROW_MAX (16UL << 20) // largest step the heap grows by at once
+#endif
+
+// transparent huge pages, -DHUGE_PAGES turns them on
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+// purging of interior free pages, counted in calls to free
+#define PURGE_INTERVAL 1024 // frees between two sweeps over the tree
+#define PURGE_DECAY 4096 // frees a tree block stays untouched before a purge
+#ifndef PURGE_ADVICE
+#define PURGE_ADVICE MADV_DONTNEED // or MADV_FREE, where the kernel has it
+#endif
+
+// arenas, override with -DMAX_ARENAS=<n> and -DARENA_SIZE=<bytes>
+#ifndef MAX_ARENAS
+#define MAX_ARENAS 64 // the main arena included
+#endif
+#ifndef ARENA_SIZE
+#define ARENA_SIZE (64UL << 20) // address space of every other arena
+#endif
+#define ARENA_STRUCT_BYTES ((sizeof(struct arena) + 7) / 8 * 8) // the run map follows it
+#define ARENA_HEADER_WORDS ((ARENA_STRUCT_BYTES + ARENA_SIZE / RUN_SIZE / 8 + 7) / 8 * 2) // even, keeps payloads aligned
+
+// slab runs of tiny objects
+#define RUN_SIZE 4096 // bytes in a run, runs are aligned to it
+#define RUN_WORDS (RUN_SIZE / 4) // block holding a run, header included
+#define SLAB_MAX 32 // largest request served from a run, in bytes
+#define SLAB_CLASSES (SLAB_MAX / 8) // slots of 8, 16, 24 and 32 bytes
+#define SLAB_MAP_MAIN ((1ULL << 34) / RUN_SIZE / 8) // bytes of the main run map, word offsets reach 16GB
+
+// quick bins, blocks freed into an arena without coalescing
+#define QUICK_BINS (EXACT_CLASS_LIMIT / 2) // one per exact size class
+#define QUICK_COUNT 64 // blocks a bin holds before it is consolidated
+
+// words in front of the place holder: list, run and quick bin heads, bin counts
+#define HEAD_WORDS (NUM_CLASSES + SLAB_CLASSES + 2 * QUICK_BINS) // even, keeps payloads aligned
+
+// thread caches
+#define TCACHE_BINS (SLAB_CLASSES + EXACT_CLASS_LIMIT / 2) // one per slot size and exact size class
+#define TCACHE_COUNT 16 // blocks a bin holds at most
+#define TCACHE_BATCH 8 // blocks moved between a bin and the heap at once
+
+struct arena {
+    pthread_mutex_t lock;
+    uint32_t *heap_base; // first word of the arena, all link offsets count from here
+    uint32_t *heap_listp;
+    char *brk; // end of the heap, arenas other than the main one
+    char *end; // end of the slot, arenas other than the main one
+
+    uint32_t *seg_free_list_header; // NUM_CLASSES list heads(offsets)
+    uint64_t seg_free_list_map; // bit i set <=> list i is not empty
+    uint32_t seg_free_tree_root; // treap of free blocks >= TREE_THRESHOLD
+    int seg_free_list_size; // free blocks in lists and tree
+
+    int trim_unsupported; // the heap cannot shrink
+    uint32_t purge_clock; // calls to free since the arena was set up
+
+    uint32_t grow_words; // least the heap grows by next, in words
+    int grow_balance; // heap_malloc minus heap_free calls since the heap last grew
+    size_t sbrk_calls; // times extend_heap grew the heap
+    size_t reserve_bytes; // free top mm_reserve asked for, free does not trim into it
+
+    size_t live_bytes; // payload of the blocks heap_malloc handed out, thread caches included
+    size_t splits; // blocks split_tail cut in two
+    size_t coalesces; // free neighbours coalesce merged
+
+    uint32_t *slab_run_header; // SLAB_CLASSES heads(offsets) of runs with free slots
+    uint32_t *quick_bin_header; // QUICK_BINS heads(offsets) of blocks freed without coalescing
+    uint32_t *quick_bin_count; // QUICK_BINS block counts
+    uint32_t quick_map; // bit i set <=> quick bin i is not empty
+    uint64_t *slab_map; // bit i set <=> page i from heap_base's page is a run
+
+    uint32_t remote_free; // blocks freed by other threads, changed without the lock
+};
+
+static struct arena main_arena = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static __thread struct arena *arena; // the arena the calling thread has locked
+static char *arena_region; // slots of arenas 1 .. MAX_ARENAS - 1
+static char *main_heap_end; // highest end the main heap ever had since mm_init
+static int arena_count; // arenas set up, the main one included, see arena_total
+static size_t heap_bytes; // heaps of all arenas together
+static size_t peak_heap_bytes; // largest heap_bytes has been since mm_init
+static int arena_limit; // one arena per CPU at most
+static uint32_t arena_next; // round robin counter
+static pthread_mutex_t arena_create_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t heap_generation; // bumped by every mm_init
+
+static pthread_mutex_t mapped_lock = PTHREAD_MUTEX_INITIALIZER;
+static void **mapped_table; // open addressing table of mapped payloads
+static size_t mapped_table_capacity; // power of 2
+static size_t mapped_count; // live mapped blocks
+static size_t mapped_bytes; // length of all live mappings
+
+static void *heap_malloc(size_t size);
+static void heap_free(void *bp);
+static void *heap_realloc(void *oldptr, size_t size);
+static void free_block(void *bp);
+static int heap_trim(size_t pad);
+static void *extend_heap(uint32_t words);
+static void *grow_heap(uint32_t words);
+static void *find_fit(uint32_t asize);
+static void place(void *bp, uint32_t asize);
+static void split_tail(void *bp, uint32_t asize);
+static void *coalesce(void *bp);
+static void addFirst(uint32_t *bp);
+static void removeBlock(uint32_t *bp);
+
+/*
+ *  Helper functions
+ *  ----------------
+ */
+
+// Align p to a multiple of w bytes
+static inline void* align(const void const* p, unsigned char w) {
+    return (void*)(((uintptr_t)(p) + (w-1)) & ~(w-1));
+}
+
+// Check if the given pointer is 8-byte aligned
+static inline int aligned(const void const* p) {
+    return align(p, 8) == p;
+}
+
+// Return the last byte of the heap of the current arena
+static inline void *heap_hi(void) {
+    return arena == &main_arena ? mem_heap_hi() : arena->brk - 1;
+}
+
+// Return whether the pointer is in the heap of the current arena.
+static inline int in_heap(const void* p) {
+    return p <= heap_hi() && p >= (void *) arena->heap_base;
+}
+
+
+/*
+ *  Block Functions
+ *  ---------------
+ *  TODO: Add your comment describing block functions here.
+ *  The functions below act similar to the macros in the book, but calculate
+ *  size in multiples of 4 bytes.
+ */
+
+// 参数全部改为指向head的指针 除了block_hdrp
+// Return the header pointer of the pointer points to payload
+
+// 参数：payload
+// 返回：header
+static inline uint32_t* block_hdrp(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block));
+
+    return block - 1;
+}
+
+// Return the size of the given block in multiples of the word size
+// 结果直接是 size based on word size, 不需要再除以WSIZE
+// 前2位: prev a/f, a/f; 后30位: block size
+
+// 参数：header / footer
+// 返回：size
+static inline unsigned int block_size(const uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return (block[0] & 0x3FFFFFFF);
+}
+
+// Return the footer pointer of the pointer points to payload,
+// only free blocks have a footer
+
+// 参数：payload
+// 返回：footer
+static inline uint32_t* block_ftrp(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block));
+    REQUIRES(!(block_hdrp(block)[0] & 0x40000000));
+
+    return block + block_size(block_hdrp(block)) - DSIZE;
+}
+
+// Return true if the block is free, false otherwise
+// 只有header或者footer可以作为此函数的参数
+
+// 参数：header / footer
+// 返回：free(1) / alloc(0)
+static inline int block_free(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return !(block[0] & 0x40000000);
+}
+
+// Return true if the previous block is free, false otherwise
+
+// 参数：header
+// 返回：free(1) / alloc(0)
+static inline int block_prev_free(const uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return !(block[0] & 0x80000000);
+}
+
+// Record in the header whether the previous block is free(1)/alloced(0)
+
+// 参数：header
+// 返回：空
+static inline void block_mark_prev(uint32_t* block, int free) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    // atomic, since the thread owning the next block may read its size
+    // without the lock, see tcache_bin_of
+    uint32_t word = __atomic_load_n(block, __ATOMIC_RELAXED);
+    __atomic_store_n(block, free ? word & 0x7FFFFFFF : word | 0x80000000, __ATOMIC_RELAXED);
+}
+
+// Mark the given block as free(1)/alloced(0) by marking the header, the
+// footer of a free block, and the prev bit of the next block's header.
+
+// 参数：header(footer同时完成)
+// 返回：空
+static inline void block_mark(uint32_t* block, int free) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
+    if(block_size(block) == 0) // epilogue or place holder
+      return;
+
+    unsigned int next = block_size(block);
+    if(free)
+      block[next - 1] = block[0]; // 设置footer对应内容
+    block_mark_prev(block + next, free);
+}
+
+// set the block size in the header, keeping only the prev bit,
+// block_mark writes the footer afterwards
+
+// 参数：header
+// 返回：空
+static inline void block_set_size(uint32_t* block, uint32_t size_in_words) {
+  REQUIRES(block != NULL);
+  REQUIRES(in_heap(block));
+
+  block[0] = size_in_words | (block[0] & 0x80000000);
+}
+
+// Return a pointer to the memory malloc should return
+
+// 参数：header
+// 返回：payload
+static inline  uint32_t* block_mem(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block + 1));
+
+    return block + 1;
+}
+
+// Return the head pointer to the previous block, which must be free
+// since only free blocks have a footer
+
+// 参数：header
+// 返回：header
+static inline uint32_t* block_prev(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(block_prev_free(block));
+
+    return block - block_size(block - WSIZE);
+}
+
+// Return the header to the next block
+
+// 参数：header
+// 返回：header
+static inline uint32_t* block_next(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return block + block_size(block);
+}
+
+
+/*
+ *  Size Class Functions
+ *  --------------------
+ */
+
+// Return the size class of a block of size words
+// classes [0, EXACT_CLASS_LIMIT / 2) hold exactly one size each,
+// the rest split every power of two into four classes
+static inline int size_class(uint32_t size) {
+    REQUIRES(size >= DSIZE);
+    REQUIRES(size < TREE_THRESHOLD);
+
+    if(size < EXACT_CLASS_LIMIT)
+      return size / 2;
+
+    int msb = 31 - __builtin_clz(size);
+    return EXACT_CLASS_LIMIT / 2 + (msb - EXACT_CLASS_SHIFT) * 4 +
+           ((size >> (msb - 2)) & 3);
+}
+
+
+
+/*
+ *  Link Functions
+ *  --------------
+ *  A free block stores its links as word offsets from arena->heap_base:
+ *  [header][prev][succ] ... [footer]
+ */
+
+// Return the block at offset, NULL for END_OF_LIST
+static inline uint32_t* from_offset(uint32_t offset) {
+    return offset == END_OF_LIST ? NULL : arena->heap_base + offset;
+}
+
+// Return the offset of block p, END_OF_LIST for NULL
+static inline uint32_t to_offset(const uint32_t* p) {
+    return p == NULL ? END_OF_LIST : (uint32_t) (p - arena->heap_base);
+}
+
+// 参数：payload
+// 返回：prev / succ free block payload
+static inline uint32_t* link_prev(const uint32_t* bp) {
+    return from_offset(bp[0]);
+}
+
+static inline uint32_t* link_succ(const uint32_t* bp) {
+    return from_offset(bp[1]);
+}
+
+// 参数：payload, prev / succ free block payload
+// 返回：空
+static inline void link_set_prev(uint32_t* bp, const uint32_t* prev) {
+    bp[0] = to_offset(prev);
+}
+
+static inline void link_set_succ(uint32_t* bp, const uint32_t* succ) {
+    bp[1] = to_offset(succ);
+}
+
+
+/*
+ *  Tree Functions
+ *  --------------
+ *  A large free block keeps its tree links right after prev and succ:
+ *  [header][prev][succ][left][right][priority][stamp] ... [footer]
+ *  A slot is a word holding the offset of a subtree, either the root or
+ *  the left/right field of its parent.
+ */
+
+// 参数：payload
+// 返回：left / right child slot
+static inline uint32_t *tree_left(uint32_t *bp) {
+    return bp + 2;
+}
+
+static inline uint32_t *tree_right(uint32_t *bp) {
+    return bp + 3;
+}
+
+// 参数：payload
+// 返回：treap priority slot
+static inline uint32_t *tree_priority(uint32_t *bp) {
+    return bp + 4;
+}
+
+// 参数：payload
+// 返回：purge stamp slot, purge_clock when bp was freed << 1 | purged
+static inline uint32_t *tree_stamp(uint32_t *bp) {
+    return bp + 5;
+}
+
+// Return the size of tree node bp
+static inline uint32_t tree_size(uint32_t *bp) {
+    return block_size(block_hdrp(bp));
+}
+
+// rotate the left child of *slot up
+static void tree_rotate_right(uint32_t *slot) {
+    uint32_t *node = from_offset(*slot);
+    uint32_t *left = from_offset(*tree_left(node));
+
+    *tree_left(node) = *tree_right(left);
+    *tree_right(left) = to_offset(node);
+    *slot = to_offset(left);
+}
+
+// rotate the right child of *slot up
+static void tree_rotate_left(uint32_t *slot) {
+    uint32_t *node = from_offset(*slot);
+    uint32_t *right = from_offset(*tree_right(node));
+
+    *tree_right(node) = *tree_left(right);
+    *tree_left(right) = to_offset(node);
+    *slot = to_offset(right);
+}
+
+// insert free block bp of size words into the subtree at *slot
+static void tree_insert(uint32_t *slot, uint32_t *bp, uint32_t size) {
+    uint32_t *node = from_offset(*slot);
+
+    if(node == NULL){ // new tree node
+      link_set_prev(bp, NULL);
+      link_set_succ(bp, NULL);
+      *tree_left(bp) = END_OF_LIST;
+      *tree_right(bp) = END_OF_LIST;
+      // address hash, so the tree shape does not depend on the free order
+      *tree_priority(bp) = (uint32_t) (((uintptr_t) bp >> 3) * 2654435761u);
+      *slot = to_offset(bp);
+      return;
+    }
+
+    if(size == tree_size(node)){ // same size, goes in the chain behind node
+      uint32_t *succ = link_succ(node);
+      link_set_prev(bp, node);
+      link_set_succ(bp, succ);
+      if(succ != NULL)
+        link_set_prev(succ, bp);
+      link_set_succ(node, bp);
+    }else if(size < tree_size(node)){
+      tree_insert(tree_left(node), bp, size);
+      if(*tree_priority(from_offset(*tree_left(node))) > *tree_priority(node))
+        tree_rotate_right(slot);
+    }else{
+      tree_insert(tree_right(node), bp, size);
+      if(*tree_priority(from_offset(*tree_right(node))) > *tree_priority(node))
+        tree_rotate_left(slot);
+    }
+}
+
+// take free block bp out of the tree
+static void tree_remove(uint32_t *bp) {
+    uint32_t *prev = link_prev(bp);
+    uint32_t *succ = link_succ(bp);
+    uint32_t size = tree_size(bp);
+    uint32_t *slot;
+
+    if(prev != NULL){ // bp is in the chain of a tree node
+      link_set_succ(prev, succ);
+      if(succ != NULL)
+        link_set_prev(succ, prev);
+      return;
+    }
+
+    // bp is a tree node, find the slot pointing to it
+    slot = &arena->seg_free_tree_root;
+    while(*slot != to_offset(bp)){
+      uint32_t *node = from_offset(*slot);
+      slot = size < tree_size(node) ? tree_left(node) : tree_right(node);
+    }
+
+    if(succ != NULL){ // first block of the chain takes bp's place
+      link_set_prev(succ, NULL);
+      *tree_left(succ) = *tree_left(bp);
+      *tree_right(succ) = *tree_right(bp);
+      *tree_priority(succ) = *tree_priority(bp);
+      *slot = to_offset(succ);
+      return;
+    }
+
+    // rotate bp down until it has at most one child, then splice it out
+    while(*tree_left(bp) != END_OF_LIST && *tree_right(bp) != END_OF_LIST){
+      if(*tree_priority(from_offset(*tree_left(bp))) >
+         *tree_priority(from_offset(*tree_right(bp)))){
+        tree_rotate_right(slot);
+        slot = tree_right(from_offset(*slot));
+      }else{
+        tree_rotate_left(slot);
+        slot = tree_left(from_offset(*slot));
+      }
+    }
+    *slot = *tree_left(bp) != END_OF_LIST ? *tree_left(bp) : *tree_right(bp);
+}
+
+// Return the smallest free block in the tree of at least asize words,
+// preferring a chained block so the tree keeps its shape
+static uint32_t *tree_best_fit(uint32_t asize) {
+    uint32_t *node = from_offset(arena->seg_free_tree_root);
+    uint32_t *best = NULL;
+
+    while(node != NULL){
+      if(tree_size(node) >= asize){
+        best = node;
+        if(tree_size(node) == asize)
+          break;
+        node = from_offset(*tree_left(node));
+      }else{
+        node = from_offset(*tree_right(node));
+      }
+    }
+
+    if(best != NULL && link_succ(best) != NULL)
+      return link_succ(best);
+    return best;
+}
+
+
+/*
+ *  Purge Functions
+ *  ---------------
+ *  Tree blocks remember when they were freed. Every PURGE_INTERVAL frees,
+ *  the whole pages inside tree blocks that stayed free for PURGE_DECAY
+ *  frees go back to the system with madvise. Header, links and footer stay
+ *  outside the purged pages, and nothing else of a free block is read.
+ */
+
+// give the whole pages of tree block bp between its stamp and its footer
+// back to the system, once it has been free for PURGE_DECAY frees
+static void purge_block(uint32_t *bp) {
+    uint32_t stamp = *tree_stamp(bp);
+#ifdef HUGE_PAGES
+    uintptr_t page = HUGE_PAGE_SIZE; // a smaller hole would split a huge page
+#else
+    uintptr_t page = mem_pagesize();
+#endif
+    uintptr_t start, end;
+
+    if((stamp & 1) || ((arena->purge_clock - (stamp >> 1)) & 0x7FFFFFFF) < PURGE_DECAY)
+      return; // purged already, or still warm
+
+    start = ((uintptr_t) (tree_stamp(bp) + 1) + page - 1) & ~(page - 1);
+    end = (uintptr_t) block_ftrp(bp) & ~(page - 1);
+    if(start < end)
+      madvise((void *) start, end - start, PURGE_ADVICE);
+    *tree_stamp(bp) = stamp | 1;
+}
+
+// purge every block of the subtree at node, chains included
+static void purge_tree(uint32_t *node) {
+    if(node == NULL)
+      return;
+
+    purge_tree(from_offset(*tree_left(node)));
+    purge_tree(from_offset(*tree_right(node)));
+    for(uint32_t *bp = node; bp != NULL; bp = link_succ(bp))
+      purge_block(bp);
+}
+
+
+/*
+ *  Mapped Block Functions
+ *  ----------------------
+ *  A mapped block is [length] [payload ...], where length is the size of
+ *  the whole mapping in bytes. Mapped blocks are never in an arena. The
+ *  table is shared by all arenas and guarded by mapped_lock, which only
+ *  mmap_alloc takes itself.
+ */
+
+// Return the mapping length for a request of size bytes
+static inline size_t mapped_length(size_t size) {
+    size_t page = mem_pagesize();
+
+    return (size + MMAP_HEADER + page - 1) & ~(page - 1);
+}
+
+// Return the payload size in bytes of mapped block bp
+static inline size_t mapped_size(void *bp) {
+
+    return *(size_t *) ((char *) bp - MMAP_HEADER) - MMAP_HEADER;
+}
+
+// Return the home slot of bp in the mapped block table
+static inline size_t mapped_slot(const void *bp) {
+    // mappings are page aligned, so the page number is what varies
+    return ((uintptr_t) bp >> 12) * 0x9E3779B97F4A7C15ULL &
+           (mapped_table_capacity - 1);
+}
+
+// Return the slot holding bp, or -1 if bp is not a live mapped block
+static long mapped_table_find(const void *bp) {
+    if(mapped_count == 0)
+      return -1;
+
+    for(size_t i = mapped_slot(bp); mapped_table[i] != NULL;
+        i = (i + 1) & (mapped_table_capacity - 1)){
+      if(mapped_table[i] == bp)
+        return i;
+    }
+    return -1;
+}
+
+// Add bp to the mapped block table, doubling it when half full;
+// return -1 if the table cannot grow
+static int mapped_table_insert(void *bp) {
+    if((mapped_count + 1) * 2 > mapped_table_capacity){
+      size_t capacity = mapped_table_capacity ? mapped_table_capacity * 2 :
+                                                MAPPED_TABLE_INIT;
+      void **old_table = mapped_table;
+      size_t old_capacity = mapped_table_capacity;
+      void **table = mmap(NULL, capacity * sizeof(void *), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+      if(table == MAP_FAILED)
+        return -1;
+      mapped_table = table;
+      mapped_table_capacity = capacity;
+      mapped_count = 0;
+      for(size_t i = 0; i < old_capacity; i++){ // rehash
+        if(old_table[i] != NULL)
+          mapped_table_insert(old_table[i]);
+      }
+      if(old_table != NULL)
+        munmap(old_table, old_capacity * sizeof(void *));
+    }
+
+    size_t i = mapped_slot(bp);
+    while(mapped_table[i] != NULL)
+      i = (i + 1) & (mapped_table_capacity - 1);
+    mapped_table[i] = bp;
+    mapped_count++;
+    return 0;
+}
+
+// Remove the entry in slot i, moving later entries of the same probe run
+// back so lookups never need tombstones
+static void mapped_table_remove(size_t i) {
+    size_t mask = mapped_table_capacity - 1;
+    size_t j = i;
+
+    mapped_table[i] = NULL;
+    while(mapped_table[j = (j + 1) & mask] != NULL){
+      size_t home = mapped_slot(mapped_table[j]);
+      // leave the entry at j if its home lies cyclically in (i, j]
+      if(((j - home) & mask) < ((j - i) & mask))
+        continue;
+      mapped_table[i] = mapped_table[j];
+      mapped_table[j] = NULL;
+      i = j;
+    }
+    mapped_count--;
+}
+
+// Return the payload of a new mapping for size bytes, NULL on failure
+static void *mmap_alloc(size_t size) {
+    size_t length = mapped_length(size);
+    char *map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(map == MAP_FAILED)
+      return NULL;
+    pthread_mutex_lock(&mapped_lock);
+    if(mapped_table_insert(map + MMAP_HEADER) < 0){
+      pthread_mutex_unlock(&mapped_lock);
+      munmap(map, length);
+      return NULL;
+    }
+    mapped_bytes += length;
+    pthread_mutex_unlock(&mapped_lock);
+    *(size_t *) map = length;
+    return map + MMAP_HEADER;
+}
+
+// Give mapped block bp in table slot i back to the kernel
+static void mmap_free(void *bp, size_t i) {
+    char *map = (char *) bp - MMAP_HEADER;
+
+    mapped_table_remove(i);
+    mapped_bytes -= *(size_t *) map;
+    munmap(map, *(size_t *) map);
+}
+
+// Resize mapped block bp in table slot i to hold size bytes, the kernel
+// moves the pages if it cannot grow the mapping where it is;
+// NULL on failure, bp is untouched
+static void *mmap_realloc(void *bp, size_t i, size_t size) {
+    char *map = (char *) bp - MMAP_HEADER;
+    size_t length = mapped_length(size);
+
+    if(length == *(size_t *) map)
+      return bp;
+    map = mremap(map, *(size_t *) map, length, MREMAP_MAYMOVE);
+    if(map == MAP_FAILED)
+      return NULL;
+    mapped_bytes += length - *(size_t *) map;
+    *(size_t *) map = length;
+    if(map + MMAP_HEADER != bp){ // moved, same number of entries so no growth
+      mapped_table_remove(i);
+      mapped_table_insert(map + MMAP_HEADER);
+    }
+    return map + MMAP_HEADER;
+}
+
+
+/*
+ *  Malloc Implementation
+ *  ---------------------
+ *  The following functions deal with the user-facing malloc implementation.
+ */
+
+/*
+ *  Arena Functions
+ *  ---------------
+ *  Functions below mm_init work on the arena the calling thread has
+ *  locked, which arena points to. heap_generation tells a thread that
+ *  mm_init started a new heap under its arena and cache.
+ */
+
+static __thread struct arena *thread_arena; // where the calling thread allocates
+static __thread uint32_t thread_arena_generation; // heap_generation of thread_arena
+
+static inline void arena_lock(struct arena *a) {
+    pthread_mutex_lock(&a->lock);
+    arena = a;
+}
+
+static inline void arena_unlock(struct arena *a) {
+    arena = NULL;
+    pthread_mutex_unlock(&a->lock);
+}
+
+// Return arena i, 0 being the main one
+static inline struct arena *arena_at(int i) {
+    return i == 0 ? &main_arena :
+                    (struct arena *) (arena_region + (i - 1) * ARENA_SIZE);
+}
+
+// Return the arena whose heap holds p, NULL for mapped blocks; takes no
+// lock, so it compares against bounds that only move in mm_init and
+// arena_create: the main heap up to the highest end it ever had, which
+// stays part of the memlib range and so never holds a mapping, and the
+// whole arena region
+static struct arena *arena_of(const void *p) {
+    char *region = __atomic_load_n(&arena_region, __ATOMIC_ACQUIRE);
+
+    if((char *) p >= (char *) main_arena.heap_base &&
+       (char *) p < __atomic_load_n(&main_heap_end, __ATOMIC_ACQUIRE))
+      return &main_arena;
+    if(region != NULL && (char *) p >= region &&
+       (char *) p < region + (MAX_ARENAS - 1) * ARENA_SIZE)
+      return arena_at(((char *) p - region) / ARENA_SIZE + 1);
+    return NULL;
+}
+
+// add incr to heap_bytes and raise peak_heap_bytes to the new total
+static void heap_bytes_add(long incr) {
+    size_t total = __atomic_add_fetch(&heap_bytes, incr, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&peak_heap_bytes, __ATOMIC_RELAXED);
+
+    while(total > peak && !__atomic_compare_exchange_n(&peak_heap_bytes, &peak, total, 1,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+}
+
+// mem_sbrk for the current arena: the main arena uses mem_sbrk itself,
+// the others move their brk inside their slot and hand the pages they
+// shrink by back to the system
+static void *arena_sbrk(int incr) {
+    char *old = arena->brk;
+    char *base = (char *) arena->heap_base + ARENA_HEADER_WORDS * 4; // mem_start_brk of the slot
+    uintptr_t page = mem_pagesize();
+
+    if(arena == &main_arena){
+      if((long) (old = mem_sbrk(incr)) < 0)
+        return old;
+      if(old + incr > main_heap_end)
+        __atomic_store_n(&main_heap_end, old + incr, __ATOMIC_RELEASE); // for arena_of
+      heap_bytes_add(incr);
+      return old;
+    }
+    if(incr > arena->end - old || incr < base - old)
+      return (void *) -1;
+
+    arena->brk = old + incr;
+    heap_bytes_add(incr);
+    if(incr < 0){
+      char *start = (char *) (((uintptr_t) arena->brk + page - 1) & ~(page - 1));
+      if(start < old)
+        madvise(start, old - start, MADV_DONTNEED);
+    }
+    return old;
+}
+
+// set up an empty heap in the current arena: list heads, place holder,
+// prologue, epilogue and a first free chunk; return -1 on error, 0 on success
+static int arena_init(void) {
+
+  // init NUM_CLASSES list heads, SLAB_CLASSES run heads, QUICK_BINS quick
+  // bin heads and counts(1 word each) + 4 words for prologue/epilogue
+  if((long)(arena->heap_listp = arena_sbrk((HEAD_WORDS + 4) * WSIZE * 4)) < 0)
+    return -1;
+
+  arena->seg_free_list_header = arena->heap_listp;
+  for(int i = 0; i < HEAD_WORDS; i++)
+    arena->seg_free_list_header[i] = END_OF_LIST; // counts start at 0 too
+  arena->slab_run_header = arena->seg_free_list_header + NUM_CLASSES;
+  arena->quick_bin_header = arena->slab_run_header + SLAB_CLASSES;
+  arena->quick_bin_count = arena->quick_bin_header + QUICK_BINS;
+  arena->quick_map = 0;
+  arena->seg_free_list_map = 0;
+  arena->seg_free_tree_root = END_OF_LIST;
+  arena->seg_free_list_size = 0;
+  arena->trim_unsupported = 0;
+  arena->purge_clock = 0;
+  arena->grow_words = CHUNKSIZE;
+  arena->grow_balance = 0;
+  arena->sbrk_calls = 0;
+  arena->reserve_bytes = 0;
+  arena->live_bytes = 0;
+  arena->splits = 0;
+  arena->coalesces = 0;
+  arena->remote_free = END_OF_LIST;
+
+  arena->heap_listp = arena->heap_listp + HEAD_WORDS; // move heap_listp to the first block
+
+  block_mark_prev(arena->heap_listp, ALLOC);
+  block_set_size(arena->heap_listp, 0); // set first block for place holder
+  block_mark(arena->heap_listp, FREE);
+
+  block_mark_prev(arena->heap_listp + WSIZE, ALLOC);
+  block_set_size(arena->heap_listp + WSIZE, OVERHEAD); // set prologue block for 1st alloc block
+  block_mark(arena->heap_listp + WSIZE, ALLOC); // also marks the epilogue's prev bit
+
+  block_set_size(arena->heap_listp + WSIZE + DSIZE, 0); // set epilogue block
+  block_mark(arena->heap_listp + WSIZE + DSIZE, ALLOC);
+
+  arena->heap_listp += DSIZE;
+
+  if(extend_heap(CHUNKSIZE) == NULL)
+    return -1;
+
+  checkheap(1);
+  return 0;
+}
+
+// set up arena number arena_count in its slot, arena_create_lock held;
+// return -1 on error, 0 on success
+static int arena_create(void) {
+    struct arena *a;
+    int err;
+
+    if(arena_count == MAX_ARENAS)
+      return -1;
+    if(arena_region == NULL){
+#ifdef HUGE_PAGES
+      // reserve a huge page more and cut the region down to a boundary
+      size_t length = (MAX_ARENAS - 1) * ARENA_SIZE + HUGE_PAGE_SIZE;
+#else
+      size_t length = (MAX_ARENAS - 1) * ARENA_SIZE;
+#endif
+      char *region = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if(region == MAP_FAILED)
+        return -1;
+#ifdef HUGE_PAGES
+      {
+        char *start = (char *) (((uintptr_t) region + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+        if(start != region)
+          munmap(region, start - region);
+        if(start + (MAX_ARENAS - 1) * ARENA_SIZE != region + length)
+          munmap(start + (MAX_ARENAS - 1) * ARENA_SIZE,
+                 region + length - (start + (MAX_ARENAS - 1) * ARENA_SIZE));
+        region = start;
+      }
+#endif
+      __atomic_store_n(&arena_region, region, __ATOMIC_RELEASE); // for arena_of
+    }
+
+    a = arena_at(arena_count);
+    pthread_mutex_init(&a->lock, NULL);
+    a->heap_base = (uint32_t *) a; // offset 0 is the arena struct, never a block
+    a->slab_map = (uint64_t *) ((char *) a + ARENA_STRUCT_BYTES);
+    a->brk = (char *) a + ARENA_HEADER_WORDS * 4;
+    a->end = (char *) a + ARENA_SIZE;
+
+    arena_lock(a);
+    err = arena_init();
+    arena_unlock(a);
+    if(err < 0)
+      return -1;
+    heap_bytes_add(ARENA_HEADER_WORDS * 4); // the arena struct and slab map
+    __atomic_store_n(&arena_count, arena_count + 1, __ATOMIC_RELEASE); // for arena_total
+    return 0;
+}
+
+// Return how many arenas are set up, for callers without arena_create_lock;
+// every arena below the count is initialized
+static inline int arena_total(void) {
+    return __atomic_load_n(&arena_count, __ATOMIC_ACQUIRE);
+}
+
+// Return the arena of the calling thread; a thread is handed the next
+// arena round robin, which is set up the first time its turn comes
+static struct arena *arena_get(void) {
+    int i;
+
+    if(thread_arena != NULL && thread_arena_generation == heap_generation)
+      return thread_arena;
+
+    pthread_mutex_lock(&arena_create_lock);
+    i = arena_next++ % arena_limit;
+    if(i >= arena_count)
+      i = arena_create() < 0 ? 0 : arena_count - 1; // out of room, share the main one
+    thread_arena = arena_at(i);
+    thread_arena_generation = heap_generation;
+    pthread_mutex_unlock(&arena_create_lock);
+    return thread_arena;
+}
+
+// push bp on the remote free stack of arena a without taking its lock,
+// linked through the first payload word like the thread caches
+static void remote_push(struct arena *a, uint32_t *bp) {
+    uint32_t offset = (uint32_t) (bp - a->heap_base);
+    uint32_t head = __atomic_load_n(&a->remote_free, __ATOMIC_RELAXED);
+
+    do{
+      bp[0] = head;
+    }while(!__atomic_compare_exchange_n(&a->remote_free, &head, offset, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// free the blocks other threads pushed on the current arena's stack; the
+// whole stack is taken at once, so pushes never race with the walk
+static void remote_drain(void) {
+    uint32_t offset;
+
+    if(__atomic_load_n(&arena->remote_free, __ATOMIC_RELAXED) == END_OF_LIST)
+      return;
+
+    offset = __atomic_exchange_n(&arena->remote_free, END_OF_LIST, __ATOMIC_ACQUIRE);
+    while(offset != END_OF_LIST){
+      uint32_t *bp = from_offset(offset);
+      offset = bp[0];
+      heap_free(bp);
+    }
+}
+
+
+/*
+ *  Thread Cache Functions
+ *  ----------------------
+ *  Bin i < SLAB_CLASSES of a thread cache holds slab slots of 8 * (i + 1)
+ *  bytes, bin SLAB_CLASSES + i allocated blocks of exactly 2 * i words of
+ *  the thread's arena, chained through the first payload word as offsets
+ *  from its heap_base, like the free lists. The cache is used
+ *  without the arena lock, so it cannot rely on arena.
+ */
+
+struct tcache {
+    uint32_t head[TCACHE_BINS];
+    uint32_t count[TCACHE_BINS];
+};
+
+static __thread struct tcache *tcache; // NULL until the thread allocates
+static __thread uint32_t tcache_generation; // heap_generation of tcache
+static pthread_key_t tcache_key; // flushes the cache when a thread exits
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+// Return the block at offset in the thread's arena, NULL for END_OF_LIST
+static inline uint32_t *tcache_block(uint32_t offset) {
+    return offset == END_OF_LIST ? NULL : thread_arena->heap_base + offset;
+}
+
+static inline void tcache_push(struct tcache *tc, int bin, uint32_t *bp) {
+    bp[0] = tc->head[bin];
+    tc->head[bin] = (uint32_t) (bp - thread_arena->heap_base);
+    tc->count[bin]++;
+}
+
+static inline uint32_t *tcache_pop(struct tcache *tc, int bin) {
+    uint32_t *bp = tcache_block(tc->head[bin]);
+
+    tc->head[bin] = bp[0];
+    tc->count[bin]--;
+    return bp;
+}
+
+// give the n oldest blocks of a bin back to the arena, its lock held
+static void tcache_flush(struct tcache *tc, int bin, uint32_t n) {
+    uint32_t *slot = &tc->head[bin];
+    uint32_t *bp;
+
+    // the link of a block is its first word, so a block is its own slot
+    for(uint32_t keep = tc->count[bin] - n; keep > 0; keep--)
+      slot = tcache_block(*slot);
+    bp = tcache_block(*slot);
+    *slot = END_OF_LIST;
+    tc->count[bin] -= n;
+
+    while(bp != NULL){
+      uint32_t *next = tcache_block(bp[0]);
+      heap_free(bp);
+      bp = next;
+    }
+}
+
+// pthread key destructor, returns a dying thread's cache to its arena
+static void tcache_release(void *tc) {
+    if(tcache_generation != heap_generation)
+      return; // the heap it lived in is gone
+
+    arena_lock(thread_arena);
+    remote_drain();
+    for(int bin = 0; bin < TCACHE_BINS; bin++)
+      tcache_flush(tc, bin, ((struct tcache *) tc)->count[bin]);
+    heap_free(tc);
+    arena_unlock(thread_arena);
+    tcache = NULL;
+}
+
+static void tcache_key_create(void) {
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+// Return the cache of the calling thread, creating it if it has none or
+// if it belongs to an earlier heap; NULL if the heap is out of memory
+static struct tcache *tcache_get(void) {
+    struct arena *a;
+
+    if(tcache != NULL && tcache_generation == heap_generation)
+      return tcache;
+
+    a = arena_get();
+    pthread_once(&tcache_key_once, tcache_key_create);
+    arena_lock(a);
+    tcache = heap_malloc(sizeof(struct tcache));
+    tcache_generation = heap_generation;
+    arena_unlock(a);
+    if(tcache != NULL){
+      memset(tcache, 0, sizeof(struct tcache));
+      pthread_setspecific(tcache_key, tcache);
+    }
+    return tcache;
+}
+
+
+/*
+ * Initialize: return -1 on error, 0 on success.
+ */
+int mm_init(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int err;
+
+  pthread_mutex_lock(&arena_create_lock);
+  heap_generation++; // arenas and thread caches of the previous heap are stale
+
+  // large blocks of the previous heap
+  pthread_mutex_lock(&mapped_lock);
+  for(size_t i = 0; i < mapped_table_capacity; i++){
+    if(mapped_table[i] != NULL){
+      char *map = (char *) mapped_table[i] - MMAP_HEADER;
+      munmap(map, *(size_t *) map);
+      mapped_table[i] = NULL;
+    }
+  }
+  mapped_count = 0;
+  mapped_bytes = 0;
+  pthread_mutex_unlock(&mapped_lock);
+
+  // other arenas of the previous heap
+  if(arena_region != NULL){
+    munmap(arena_region, (MAX_ARENAS - 1) * ARENA_SIZE);
+    __atomic_store_n(&arena_region, NULL, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&arena_count, 1, __ATOMIC_RELEASE);
+  arena_next = 0;
+  arena_limit = cpus < 1 ? 1 : cpus < MAX_ARENAS ? cpus : MAX_ARENAS;
+  pthread_mutex_unlock(&arena_create_lock);
+
+  arena_lock(&main_arena);
+  main_arena.heap_base = (uint32_t *) mem_heap_lo();
+  __atomic_store_n(&main_heap_end, (char *) mem_heap_hi() + 1, __ATOMIC_RELEASE);
+#ifdef HUGE_PAGES
+  {
+    // the list heads go right after the first huge page boundary
+    size_t pad = (HUGE_PAGE_SIZE - (uintptr_t) mem_heap_lo() % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    if(pad != 0 && (long) mem_sbrk(pad) < 0){
+      arena_unlock(&main_arena);
+      return -1;
+    }
+  }
+#endif
+  if(main_arena.slab_map == NULL){
+    void *map = mmap(NULL, SLAB_MAP_MAIN, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(map == MAP_FAILED){
+      arena_unlock(&main_arena);
+      return -1;
+    }
+    main_arena.slab_map = map;
+  }else{
+    madvise(main_arena.slab_map, SLAB_MAP_MAIN, MADV_DONTNEED); // zero, the old runs are gone
+  }
+  __atomic_store_n(&heap_bytes, (size_t) ((char *) mem_heap_hi() + 1 - (char *) mem_heap_lo()),
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&peak_heap_bytes, __atomic_load_n(&heap_bytes, __ATOMIC_RELAXED),
+                   __ATOMIC_RELAXED);
+  err = arena_init();
+  arena_unlock(&main_arena);
+  return err;
+}
+
+static void *extend_heap(uint32_t words){
+
+  uint32_t *bp;
+  uint32_t size;
+
+  size = (words % 2) ? ((words + 1) * 4) : (words * 4); // convert to bytes
+#ifdef HUGE_PAGES
+  // end on a huge page boundary, so the last huge page is a whole one
+  size += (HUGE_PAGE_SIZE - ((uintptr_t) heap_hi() + 1 + size) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+#endif
+  if((long)(bp = arena_sbrk(size)) < 0)  // use long for 64-bits machine!
+    return NULL;
+  arena->sbrk_calls++;
+#ifdef HUGE_PAGES
+  {
+    uintptr_t start = (uintptr_t) bp & ~(uintptr_t) (mem_pagesize() - 1);
+    madvise((void *) start, (uintptr_t) bp + size - start, MADV_HUGEPAGE);
+  }
+#endif
+
+  // the old epilogue becomes the header and keeps its prev bit
+  block_set_size(block_hdrp(bp), size / 4); // bp is not the header, but the payload pointer
+
+  block_set_size(block_next(block_hdrp(bp)), 0); // set epilogue
+  block_mark(block_next(block_hdrp(bp)), ALLOC);
+
+  block_mark(block_hdrp(bp), FREE); // footer and the epilogue's prev bit
+
+  return coalesce(bp); // coalesce puts the new block on its list
+}
+
+// words the heap grows by at least next: the current step while the arena
+// hands out more blocks than it takes back, CHUNKSIZE once it does not
+static inline uint32_t grow_step(void){
+  return arena->grow_balance > 0 ? arena->grow_words : CHUNKSIZE;
+}
+
+// extend_heap for a request of words, by grow_step() if that is more; the
+// step doubles with every growth
+static void *grow_heap(uint32_t words){
+  uint32_t step = grow_step();
+  void *bp;
+
+  if((bp = extend_heap(MAX(words, step))) == NULL && words < step)
+    bp = extend_heap(MAX(words, CHUNKSIZE)); // the step does not fit, the request may
+  if(bp == NULL)
+    return NULL;
+
+  arena->grow_words = step * 2 <= GROW_MAX / 4 ? step * 2 : GROW_MAX / 4;
+  arena->grow_balance = 0;
+  return bp;
+}
+
+// add free block bp to the first element of the list for its size class,
+// or to the tree if it is large, the block size must already be set
+static void addFirst(uint32_t *bp){
+  uint32_t size = block_size(block_hdrp(bp));
+
+  if(size >= TREE_THRESHOLD){
+    tree_insert(&arena->seg_free_tree_root, bp, size);
+    *tree_stamp(bp) = arena->purge_clock << 1; // dirty as of now
+    arena->seg_free_list_size++;
+    return;
+  }
+
+  int class = size_class(size);
+  uint32_t *first = from_offset(arena->seg_free_list_header[class]);
+
+  link_set_prev(bp, NULL);
+  link_set_succ(bp, first);
+  if(first != NULL)
+    link_set_prev(first, bp); // old first block points back to bp
+  arena->seg_free_list_header[class] = to_offset(bp);
+  arena->seg_free_list_map |= 1ULL << class;
+  arena->seg_free_list_size++;
+}
+
+// take free block bp off its list or out of the tree,
+// must be called before its size changes
+static void removeBlock(uint32_t *bp){
+  uint32_t size = block_size(block_hdrp(bp));
+
+  if(size >= TREE_THRESHOLD){
+    tree_remove(bp);
+    arena->seg_free_list_size--;
+    return;
+  }
+
+  uint32_t *prev = link_prev(bp);
+  uint32_t *succ = link_succ(bp);
+
+  if(prev == NULL){ // bp is the first block of its class
+    int class = size_class(size);
+    arena->seg_free_list_header[class] = to_offset(succ);
+    if(succ == NULL) // and the last one
+      arena->seg_free_list_map &= ~(1ULL << class);
+  }else{
+    link_set_succ(prev, succ);
+  }
+
+  if(succ != NULL)
+    link_set_prev(succ, prev);
+
+  // for safety
+  link_set_prev(bp, NULL);
+  link_set_succ(bp, NULL);
+  arena->seg_free_list_size--;
+}
+
+// Return the block size in words for a request of size bytes
+// allocated blocks only pay for the header, but must still be big
+// enough to hold a free block's links and footer once they are freed,
+// so the minimum block is 16 bytes
+static inline size_t adjust_size(size_t size){
+  size_t asize = 8 * ((size + 4 + (8 - 1)) / 8);
+
+  return MAX(asize / 4, MIN_BLOCK); // convert bytes to words
+}
+
+
+/*
+ *  Quick Bin Functions
+ *  -------------------
+ *  Bin i holds allocated blocks of exactly 2 * i words, chained through the
+ *  first payload word as offsets, like the thread caches. The bins are
+ *  freed for real when find_fit comes back empty, when a bin grows past
+ *  QUICK_COUNT blocks, and by mm_trim and mm_reserve.
+ */
+
+// Return a block of exactly asize words from its bin, NULL if it is empty
+static uint32_t *quick_pop(uint32_t asize) {
+    int i = asize / 2;
+    uint32_t *bp;
+
+    if(asize >= EXACT_CLASS_LIMIT || !(arena->quick_map >> i & 1))
+      return NULL;
+    bp = from_offset(arena->quick_bin_header[i]);
+    arena->quick_bin_header[i] = bp[0];
+    if(--arena->quick_bin_count[i] == 0)
+      arena->quick_map &= ~(1U << i);
+    return bp;
+}
+
+// free every block in bin i for real, one at a time, so that the bin and
+// live_bytes agree with the heap whenever free_block checks it
+static void quick_flush(int i) {
+    uint32_t *bp;
+
+    while((bp = quick_pop(2 * i)) != NULL)
+      free_block(bp);
+}
+
+// free the blocks of all bins for real; return whether there were any
+static int quick_consolidate(void) {
+    int any = arena->quick_map != 0;
+
+    while(arena->quick_map != 0)
+      quick_flush(__builtin_ctz(arena->quick_map));
+    return any;
+}
+
+// put block bp of size words in its bin, consolidating the bin when it
+// grows past QUICK_COUNT
+static void quick_push(uint32_t *bp, uint32_t size) {
+    int i = size / 2;
+
+    bp[0] = arena->quick_bin_header[i];
+    arena->quick_bin_header[i] = to_offset(bp);
+    arena->quick_map |= 1U << i;
+    if(++arena->quick_bin_count[i] > QUICK_COUNT)
+      quick_flush(i);
+}
+
+
+/*
+ *  Slab Functions
+ *  --------------
+ *  A run is the payload of an allocated block of RUN_WORDS, placed so that
+ *  the payload starts on a RUN_SIZE boundary; the header of the next block
+ *  takes the last word of the page, so runs carved one after another tile
+ *  the heap without gaps:
+ *  [prev][succ][slot size, counts][used bitmap] [slot] [slot] ...
+ *  prev and succ link the runs of a class that have free slots, as offsets
+ *  like the free lists. Bits of the bitmap past the last slot stay set.
+ */
+
+struct slab_run {
+    uint32_t prev; // runs with free slots of the same size
+    uint32_t succ;
+    uint16_t slot_size; // bytes
+    uint16_t nslots;
+    uint16_t free_slots;
+    uint16_t first_slot; // bytes from the run to slot 0
+    uint64_t used[(RUN_SIZE / 8 + 63) / 64]; // bit i set <=> slot i allocated
+};
+
+// Return the slab class of a request of size bytes, at most SLAB_MAX
+static inline int slab_class(size_t size) {
+    REQUIRES(size > 0 && size <= SLAB_MAX);
+
+    return (size + 7) / 8 - 1;
+}
+
+// Return the run map word of arena a covering the page of p, and its bit
+static inline uint64_t *slab_map_word(struct arena *a, const void *p, uint64_t *bit) {
+    uintptr_t first_page = (uintptr_t) a->heap_base & ~(uintptr_t) (RUN_SIZE - 1);
+    uintptr_t page = ((uintptr_t) p - first_page) / RUN_SIZE;
+
+    *bit = 1ULL << (page % 64);
+    return &a->slab_map[page / 64];
+}
+
+// Return the run holding p if p is a slot of arena a, NULL otherwise;
+// needs no lock for a block the caller owns, since its run cannot go away
+static inline struct slab_run *slab_run_of(struct arena *a, const void *p) {
+    uint64_t bit;
+    uint64_t *word = slab_map_word(a, p, &bit);
+
+    if(!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit))
+      return NULL;
+    return (struct slab_run *) ((uintptr_t) p & ~(uintptr_t) (RUN_SIZE - 1));
+}
+
+// put run at the front of the list of its class
+static void run_insert(int class, struct slab_run *run) {
+    uint32_t *rp = (uint32_t *) run;
+    uint32_t *first = from_offset(arena->slab_run_header[class]);
+
+    link_set_prev(rp, NULL);
+    link_set_succ(rp, first);
+    if(first != NULL)
+      link_set_prev(first, rp);
+    arena->slab_run_header[class] = to_offset(rp);
+}
+
+// take run off the list of its class
+static void run_remove(int class, struct slab_run *run) {
+    uint32_t *rp = (uint32_t *) run;
+    uint32_t *prev = link_prev(rp);
+    uint32_t *succ = link_succ(rp);
+
+    if(prev == NULL)
+      arena->slab_run_header[class] = to_offset(succ);
+    else
+      link_set_succ(prev, succ);
+    if(succ != NULL)
+      link_set_prev(succ, prev);
+}
+
+// Return where a run goes in the free block bp: the first RUN_SIZE
+// boundary that leaves either nothing or a whole block in front of it
+static inline char *run_start(uint32_t *bp) {
+    char *run = (char *) (((uintptr_t) bp + RUN_SIZE - 1) & ~(uintptr_t) (RUN_SIZE - 1));
+
+    if(run != (char *) bp && run - (char *) bp < MIN_BLOCK * 4)
+      run += RUN_SIZE;
+    return run;
+}
+
+// carve a run for class out of the heap: find a free block that holds an
+// aligned run, or grow the top of the heap just enough for one, then free
+// the part in front of the run and split off the part behind it;
+// NULL if the heap cannot grow
+static struct slab_run *run_create(int class) {
+    uint32_t *bp, *hdr, lead;
+    struct slab_run *run;
+    uint64_t bit;
+
+    if((bp = find_fit(RUN_WORDS)) == NULL ||
+       (run_start(bp) - (char *) bp) / 4 + RUN_WORDS > block_size(block_hdrp(bp))){
+      // a block this big holds a run wherever it starts
+      if((bp = find_fit(RUN_WORDS + (RUN_SIZE + MIN_BLOCK * 4) / 4)) == NULL &&
+         quick_consolidate())
+        return run_create(class); // the binned blocks may have made room
+      if(bp == NULL){
+        uint32_t *epilogue = (uint32_t *) ((char *) heap_hi() + 1) - WSIZE;
+        uint32_t *top = block_mem(epilogue); // where extend_heap's block starts
+        int need;
+
+        if(block_prev_free(epilogue))
+          top = block_mem(block_prev(epilogue));
+        need = (run_start(top) - (char *) top) / 4 + RUN_WORDS -
+               (block_prev_free(epilogue) ? block_size(block_hdrp(top)) : 0);
+        if(need <= 0) // the free top holds one already
+          bp = top;
+        else if((bp = grow_heap(need)) == NULL)
+          return NULL;
+      }
+    }
+    place(bp, block_size(block_hdrp(bp)));
+
+    run = (struct slab_run *) run_start(bp);
+    hdr = block_hdrp(bp);
+    lead = (uint32_t *) run - bp;
+    if(lead != 0){
+      uint32_t *run_hdr = hdr + lead;
+
+      run_hdr[0] = 0;
+      block_set_size(run_hdr, block_size(hdr) - lead);
+      block_mark(run_hdr, ALLOC);
+      block_set_size(hdr, lead);
+      block_mark(hdr, FREE); // footer and the run's prev bit
+      coalesce(bp);
+    }
+    split_tail(run, RUN_WORDS);
+
+    memset(run, 0, sizeof(struct slab_run));
+    run->slot_size = 8 * (class + 1);
+    run->first_slot = (sizeof(struct slab_run) + 7) / 8 * 8;
+    run->nslots = ((RUN_WORDS - 1) * 4 - run->first_slot) / run->slot_size; // payload ends a word short
+    run->free_slots = run->nslots;
+    for(int i = run->nslots; i < 64 * (int) (sizeof(run->used) / 8); i++)
+      run->used[i / 64] |= 1ULL << (i % 64); // no such slot
+    run_insert(class, run);
+
+    uint64_t *word = slab_map_word(arena, run, &bit);
+    __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+    return run;
+}
+
+// Return a free slot for a request of size bytes, NULL if the heap is full
+static void *slab_alloc(size_t size) {
+    int class = slab_class(size);
+    struct slab_run *run = (struct slab_run *) from_offset(arena->slab_run_header[class]);
+    int w = 0;
+
+    if(run == NULL && (run = run_create(class)) == NULL)
+      return NULL;
+
+    while(run->used[w] == ~0ULL) // a run on the list has a free slot
+      w++;
+    int i = 64 * w + __builtin_ctzll(~run->used[w]);
+    run->used[w] |= 1ULL << (i % 64);
+    if(--run->free_slots == 0)
+      run_remove(class, run);
+    return (char *) run + run->first_slot + i * run->slot_size;
+}
+
+// give slot bp of run back; an empty run goes back to the heap unless no
+// other run of its class has a free slot
+static void slab_free(struct slab_run *run, void *bp) {
+    int class = run->slot_size / 8 - 1;
+    int i = ((char *) bp - (char *) run - run->first_slot) / run->slot_size;
+    uint64_t bit;
+
+    run->used[i / 64] &= ~(1ULL << (i % 64));
+    if(run->free_slots++ == 0){
+      run_insert(class, run);
+      return;
+    }
+    if(run->free_slots < run->nslots ||
+       (link_prev((uint32_t *) run) == NULL && link_succ((uint32_t *) run) == NULL))
+      return;
+
+    run_remove(class, run);
+    uint64_t *word = slab_map_word(arena, run, &bit);
+    __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    free_block(run); // an ordinary block again, never counted as live
+}
+
+// Return the thread cache bin of allocated block bp of arena a, -1 if it
+// is too big to be cached; reads only what free may read without the lock
+static inline int tcache_bin_of(struct arena *a, uint32_t *bp) {
+    struct slab_run *run = slab_run_of(a, bp);
+    uint32_t size;
+
+    if(run != NULL)
+      return slab_class(run->slot_size);
+
+    // the size bits of an allocated block's header only change under the
+    // lock of its arena by the thread owning the block, so they can be read;
+    // other threads may flip bit 31 under the lock meanwhile, which
+    // block_mark_prev does atomically and which does not touch the size
+    size = __atomic_load_n(&bp[-1], __ATOMIC_RELAXED) & 0x3FFFFFFF;
+    return size < EXACT_CLASS_LIMIT ? SLAB_CLASSES + (int) size / 2 : -1;
+}
+
+/*
+ * malloc - small sizes come from the thread cache, refilled in a batch
+ * when it runs dry; everything else from the thread's arena under its
+ * lock, or from the main arena once the thread's arena is full
+ */
+void *malloc (size_t size) {
+  struct arena *a;
+  struct tcache *tc;
+  uint32_t *bp;
+  int bin;
+
+  if(size == 0)
+    return NULL;
+
+  a = arena_get();
+  if((size <= SLAB_MAX || adjust_size(size) < EXACT_CLASS_LIMIT) &&
+     (tc = tcache_get()) != NULL){
+    bin = size <= SLAB_MAX ? slab_class(size) : SLAB_CLASSES + (int) adjust_size(size) / 2;
+    if(tc->count[bin] > 0)
+      return tcache_pop(tc, bin);
+
+    arena_lock(a);
+    bp = heap_malloc(size);
+    for(int i = 1; bp != NULL && i < TCACHE_BATCH; i++){
+      uint32_t *extra = heap_malloc(size);
+      if(extra == NULL)
+        break;
+      if(tcache_bin_of(a, extra) != bin){
+        heap_free(extra); // too small to split, it would sit in the wrong bin
+        break;
+      }
+      tcache_push(tc, bin, extra);
+    }
+    arena_unlock(a);
+  }else{
+    arena_lock(a);
+    bp = heap_malloc(size);
+    arena_unlock(a);
+  }
+
+  if(bp == NULL && a != &main_arena){ // its slot is full
+    arena_lock(&main_arena);
+    bp = heap_malloc(size);
+    arena_unlock(&main_arena);
+  }
+  return bp;
+}
+
+// malloc for callers holding an arena lock
+static void *heap_malloc(size_t size) {
+  checkheap(1);  // Let's make sure the heap is ok!
+  size_t asize;  // actual size
+  size_t extendsize;
+  uint32_t *bp;
+
+  remote_drain(); // may make room before anything is searched
+
+  if(size <= 0)
+    return NULL;
+  arena->grow_balance++;
+
+  if(size <= SLAB_MAX){
+    if((bp = slab_alloc(size)) != NULL)
+      arena->live_bytes += slab_run_of(arena, bp)->slot_size;
+    checkheap(1);
+    return bp;
+  }
+
+  // a large request that cannot get a mapping still tries the heap
+  if(size >= MMAP_THRESHOLD && (bp = mmap_alloc(size)) != NULL)
+    return bp;
+
+  asize = adjust_size(size);
+
+  if((bp = quick_pop(asize)) != NULL){ // freed earlier, still allocated
+    arena->live_bytes += (block_size(block_hdrp(bp)) - 1) * 4;
+    checkheap(1);
+    return bp;
+  }
+
+  if((bp = find_fit(asize)) != NULL ||
+     (quick_consolidate() && (bp = find_fit(asize)) != NULL)){ // find fit place
+    place(bp, asize);
+    arena->live_bytes += (block_size(block_hdrp(bp)) - 1) * 4;
+    checkheap(1);
+    return bp;
+  }
+
+  extendsize = asize; // do not find fit place
+  if((bp = grow_heap(extendsize / WSIZE)) == NULL)
+    return NULL;
+  place(bp, asize);
+  arena->live_bytes += (block_size(block_hdrp(bp)) - 1) * 4; // payload, no footer
+  checkheap(1);
+  return bp;
+}
+
+// find fit for segregated free list
+// best fit inside the request's own class, since blocks there can still be
+// smaller than asize; any block of a larger class fits, so take the first
+// one of the lowest non-empty class above it; large requests and requests
+// no list can serve get the best fit from the tree
+static void *find_fit(uint32_t asize){
+  if(asize >= TREE_THRESHOLD)
+    return tree_best_fit(asize);
+
+  int class = size_class(asize);
+  uint32_t *iter_ptr = from_offset(arena->seg_free_list_header[class]);
+  uint64_t larger;
+
+  uint32_t *best_fit_pointer = NULL;
+  uint32_t best_fit_size = 0; // csize - asize
+  uint32_t csize;
+
+  if(class < EXACT_CLASS_LIMIT / 2 && iter_ptr != NULL)
+    return iter_ptr; // exact class, the first block fits exactly
+
+  while(iter_ptr != NULL){
+    csize = block_size(block_hdrp(iter_ptr));
+    if(asize <= csize &&
+      (best_fit_pointer == NULL || csize - asize < best_fit_size)){
+      best_fit_pointer = iter_ptr;
+      best_fit_size = csize - asize;
+      if(best_fit_size == 0) // exact fit, always the case for small classes
+        break;
+    }
+    iter_ptr = link_succ(iter_ptr); // move to the succ block
+  }
+  if(best_fit_pointer != NULL)
+    return best_fit_pointer;
+
+  larger = class + 1 < NUM_CLASSES ? arena->seg_free_list_map & (~0ULL << (class + 1)) : 0;
+  if(larger == 0)
+    return tree_best_fit(asize);
+  return from_offset(arena->seg_free_list_header[__builtin_ctzll(larger)]);
+}
+
+static void place(void *bp, uint32_t asize){
+  uint32_t *hdr = block_hdrp(bp);
+  uint32_t stamp = block_size(hdr) >= TREE_THRESHOLD ? *tree_stamp(bp) : 0;
+
+  removeBlock(bp);
+  block_mark(hdr, ALLOC);
+  split_tail(bp, asize);
+
+  // the pages of a large tail are as old as those of the block it was cut
+  // from, only its first words were written; it may be purged again, the
+  // block was purged or prefaulted as a whole, not the tail on its own
+  if(block_size(block_next(hdr)) >= TREE_THRESHOLD &&
+     block_free(block_next(hdr)))
+    *tree_stamp(block_mem(block_next(hdr))) = stamp & ~1U;
+}
+
+// cut allocated block bp down to asize words and free the tail, as long as
+// the tail is big enough to be a block of its own
+static void split_tail(void *bp, uint32_t asize){
+  uint32_t csize = block_size(block_hdrp(bp));
+
+  // splitting condition is the minimum block size(4 words)
+  if((csize - asize) < MIN_BLOCK) // do not split the block
+    return;
+  arena->splits++;
+
+  block_set_size(block_hdrp(bp), asize);
+  block_mark(block_hdrp(bp), ALLOC);
+
+  bp = block_mem(block_next(block_hdrp(bp))); // bp points to next split block's payload
+
+  block_set_size(block_hdrp(bp), csize - asize);
+  block_mark(block_hdrp(bp), FREE);
+
+  // the tail may belong to a smaller class, or touch a free block when
+  // realloc shrinks a block
+  coalesce(bp);
+}
+
+
+/*
+ * free - small blocks of the thread's own arena go to the thread cache,
+ * which gives its oldest TCACHE_BATCH blocks back when it overflows;
+ * blocks of other arenas go on their remote free stack
+ */
+void free(void *bp) {
+  struct arena *a;
+  struct tcache *tc;
+  int bin;
+
+  if((long)bp <= 0)
+    return;
+
+  if((a = arena_of(bp)) == NULL){ // large block with its own mapping
+    pthread_mutex_lock(&mapped_lock);
+    long i = mapped_table_find(bp);
+    if(i >= 0)
+      mmap_free(bp, i);
+    pthread_mutex_unlock(&mapped_lock);
+    return;
+  }
+
+  if(a != thread_arena || thread_arena_generation != heap_generation){
+    remote_push(a, bp);
+    return;
+  }
+
+  if((bin = tcache_bin_of(a, bp)) >= 0 && (tc = tcache_get()) != NULL){
+    tcache_push(tc, bin, bp);
+    if(tc->count[bin] > TCACHE_COUNT){
+      arena_lock(a);
+      tcache_flush(tc, bin, TCACHE_BATCH);
+      arena_unlock(a);
+    }
+    return;
+  }
+
+  arena_lock(a);
+  remote_drain();
+  heap_free(bp);
+  arena_unlock(a);
+}
+
+// free for callers holding the lock of the arena of bp
+static void heap_free(void *bp) {
+  struct slab_run *run;
+
+  if((long)bp <= 0)
+    return;
+  checkheap(1);
+  arena->grow_balance--;
+  if((run = slab_run_of(arena, bp)) != NULL){
+    arena->live_bytes -= run->slot_size;
+    slab_free(run, bp);
+    checkheap(1);
+    return;
+  }
+  arena->live_bytes -= (block_size(block_hdrp(bp)) - 1) * 4; // payload, no footer
+  if(block_size(block_hdrp(bp)) < EXACT_CLASS_LIMIT){
+    quick_push(bp, block_size(block_hdrp(bp)));
+    checkheap(1);
+    return;
+  }
+  free_block(bp);
+}
+
+// mark bp free and coalesce it right away
+static void free_block(void *bp) {
+  block_mark(block_hdrp(bp), FREE);
+
+  bp = coalesce(bp);
+  if(block_size(block_next(block_hdrp(bp))) == 0 && // top of the heap
+     block_size(block_hdrp(bp)) * 4 >= MAX(TRIM_THRESHOLD, grow_step() * 8) + arena->reserve_bytes)
+    heap_trim(MAX(TRIM_PAD, arena->reserve_bytes)); // a top the next growth would fill again stays
+  if(++arena->purge_clock % PURGE_INTERVAL == 0)
+    purge_tree(from_offset(arena->seg_free_tree_root));
+  checkheap(1);
+}
+
+// merge bp with its free neighbours and put the result on the list of its
+// new size class, bp itself must not be on any list yet
+static void *coalesce(void *bp){
+
+  int prev_free = block_prev_free(block_hdrp(bp));
+
+  int next_free = block_free(block_next(block_hdrp(bp)));
+
+  uint32_t size = block_size(block_hdrp(bp));
+
+
+  if(!prev_free && !next_free){ // no need to coalesce
+  }
+
+  else if(!prev_free && next_free){ // merge next
+    arena->coalesces++;
+    removeBlock(block_mem(block_next(block_hdrp(bp))));
+
+    size += block_size(block_next(block_hdrp(bp)));
+    block_set_size(block_hdrp(bp), size);
+    block_mark(block_hdrp(bp), FREE);
+  }
+
+  else if(prev_free && !next_free){ // merge prev
+    arena->coalesces++;
+    removeBlock(block_mem(block_prev(block_hdrp(bp))));
+
+    size += block_size(block_prev(block_hdrp(bp)));
+    bp = block_mem(block_prev(block_hdrp(bp)));
+    block_set_size(block_hdrp(bp), size);
+    block_mark(block_hdrp(bp), FREE);
+  }
+
+  else{ // merge prev and next
+    arena->coalesces += 2;
+    removeBlock(block_mem(block_next(block_hdrp(bp))));
+    removeBlock(block_mem(block_prev(block_hdrp(bp))));
+
+    size += block_size(block_prev(block_hdrp(bp))) +
+            block_size(block_next(block_hdrp(bp)));
+    bp = block_mem(block_prev(block_hdrp(bp)));
+    block_set_size(block_hdrp(bp), size);
+    block_mark(block_hdrp(bp), FREE);
+  }
+
+  addFirst(bp);
+  return bp;
+}
+
+
+/*
+ * realloc - resize in place whenever the block can grow into a free next
+ * block or the top of the heap, or shrink; move the block only otherwise.
+ * Mapped blocks are resized with mremap.
+ */
+void *realloc(void *oldptr, size_t size) {
+  struct arena *a;
+  size_t oldsize;
+  void *newptr;
+
+  if(size == 0){
+    free(oldptr);
+    return NULL; // should return NULL
+  }
+
+  if(oldptr == NULL){
+    return malloc(size);
+  }
+
+  if((a = arena_of(oldptr)) == NULL){ // mapped block
+    pthread_mutex_lock(&mapped_lock);
+    long i = mapped_table_find(oldptr);
+    if(i < 0 || size >= MMAP_THRESHOLD){
+      newptr = i < 0 ? NULL : mmap_realloc(oldptr, i, size);
+      pthread_mutex_unlock(&mapped_lock);
+      return newptr;
+    }
+    pthread_mutex_unlock(&mapped_lock);
+    oldsize = mapped_size(oldptr); // small enough for an arena again
+  }else{
+    struct slab_run *run;
+
+    arena_lock(a);
+    if((newptr = heap_realloc(oldptr, size)) == NULL)
+      oldsize = (run = slab_run_of(a, oldptr)) != NULL ? run->slot_size :
+                (block_size(block_hdrp(oldptr)) - 1) * 4; // payload, no footer
+    arena_unlock(a);
+    if(newptr != NULL)
+      return newptr;
+    // out of memory in its arena, maybe not in the main one
+  }
+
+  if((newptr = malloc(size)) == NULL)
+    return NULL;
+  memcpy(newptr, oldptr, size < oldsize ? size : oldsize);
+  free(oldptr);
+  return newptr;
+}
+
+// realloc for callers holding the lock of the arena of oldptr,
+// oldptr is not NULL and size not 0
+static void *heap_realloc(void *oldptr, size_t size) {
+  struct slab_run *run;
+  size_t oldsize;
+  size_t asize;
+  void *newptr;
+  checkheap(1);
+
+  if((run = slab_run_of(arena, oldptr)) != NULL){ // slots never change size
+    if(size <= run->slot_size)
+      return oldptr;
+    if((newptr = heap_malloc(size)) == NULL)
+      return NULL;
+    memcpy(newptr, oldptr, run->slot_size);
+    heap_free(oldptr);
+    return newptr;
+  }
+
+  asize = adjust_size(size);
+
+  uint32_t *hdr = block_hdrp(oldptr);
+  uint32_t *next = block_next(hdr);
+  size_t avail = block_size(hdr); // what oldptr can get without moving
+
+  if(block_free(next))
+    avail += block_size(next);
+
+  if(asize > avail && size < MMAP_THRESHOLD &&
+    block_size(block_free(next) ? block_next(next) : next) == 0){
+    // oldptr is the last block, maybe followed by one free block: grow the
+    // heap, extend_heap merges the new space into a free block after oldptr;
+    // large sizes move to a mapping instead
+    if(grow_heap(asize - avail) == NULL)
+      return NULL;
+    next = block_next(hdr);
+    avail = block_size(hdr) + block_size(next);
+  }
+
+  if(asize <= avail){
+    arena->live_bytes -= block_size(hdr) * 4;
+    if(avail > block_size(hdr)){ // take over the free next block
+      removeBlock(block_mem(next));
+      block_set_size(hdr, avail);
+      block_mark(hdr, ALLOC);
+    }
+    split_tail(oldptr, asize);
+    arena->live_bytes += block_size(hdr) * 4; // the footer word cancels out
+    checkheap(1);
+    return oldptr;
+  }
+
+  newptr = heap_malloc(size);
+
+  if(!newptr){
+    return 0;
+  }
+
+  oldsize = block_size(block_hdrp(oldptr)) - 1; // payload, no footer
+  oldsize *= 4;
+  if(size < oldsize) // convert words to bytes
+    oldsize = size;
+  memcpy(newptr, oldptr, oldsize);
+
+  heap_free(oldptr);
+  checkheap(1);
+  return newptr;
+}
+
+/*
+ * mm_trim - shrink the heap of every arena so that at most pad bytes of
+ * the free block at its top remain. Returns 1 if a heap shrank, 0 otherwise.
+ */
+int mm_trim(size_t pad) {
+  int trimmed = 0;
+  int n = arena_total();
+
+  for(int i = 0; i < n; i++){
+    arena_lock(arena_at(i));
+    quick_consolidate(); // binned blocks at the top would pin it
+    trimmed |= heap_trim(pad);
+    arena_unlock(arena_at(i));
+  }
+  return trimmed;
+}
+
+/*
+ * mm_sbrk_calls - return how many times the heaps of all arenas grew since
+ * mm_init.
+ */
+size_t mm_sbrk_calls(void) {
+  size_t calls = 0;
+  int n = arena_total();
+
+  for(int i = 0; i < n; i++){
+    arena_lock(arena_at(i));
+    calls += arena->sbrk_calls;
+    arena_unlock(arena_at(i));
+  }
+  return calls;
+}
+
+/*
+ * mm_reserve - grow the heap of the calling thread's arena once so that
+ * its top is a single free block of at least bytes, and fault its pages in
+ * if prefault is set. The block is kept from being purged while it is
+ * whole; what malloc leaves of it is purged like any other idle block.
+ * Returns 0 on success, -1 if the heap cannot grow that far.
+ */
+int mm_reserve(size_t bytes, int prefault) {
+  struct arena *a = arena_get();
+  size_t words = (bytes + 7) / 8 * 2; // even, keeps payloads aligned
+  uint32_t *epilogue, *hdr;
+  size_t top = 0;
+  size_t room;
+
+  if(bytes > INT_MAX)
+    return -1; // more than one arena_sbrk can add
+  if(words < MIN_BLOCK)
+    words = MIN_BLOCK;
+
+  arena_lock(a);
+  quick_consolidate(); // binned blocks at the top would cut it short
+  epilogue = (uint32_t *) ((char *) heap_hi() + 1) - WSIZE;
+  if(block_prev_free(epilogue))
+    top = block_size(block_prev(epilogue));
+  // the main heap grows by an int at a time, the others up to the end of their slot
+  room = a == &main_arena ? (size_t) INT_MAX & ~7 : (size_t) (a->end - a->brk);
+#ifdef HUGE_PAGES
+  room = room > HUGE_PAGE_SIZE ? room - HUGE_PAGE_SIZE : 0; // extend_heap pads up to one
+#endif
+  if(top < words && ((words - top) * 4 > room || extend_heap(words - top) == NULL)){ // merges with the free top
+    arena_unlock(a);
+    return -1;
+  }
+  if(bytes > a->reserve_bytes)
+    a->reserve_bytes = bytes;
+
+  epilogue = (uint32_t *) ((char *) heap_hi() + 1) - WSIZE;
+  hdr = block_prev(epilogue);
+  if(prefault && block_size(hdr) >= TREE_THRESHOLD){
+    // the pages between the tree links and the footer, the others hold
+    // header, links and footer and are faulted in already
+    uint32_t *bp = block_mem(hdr);
+    uintptr_t page = mem_pagesize();
+    uintptr_t start = ((uintptr_t) (tree_stamp(bp) + 1) + page - 1) & ~(page - 1);
+    uintptr_t end = (uintptr_t) block_ftrp(bp) & ~(page - 1);
+
+    if(start < end){
+#ifdef MADV_POPULATE_WRITE
+      if(madvise((void *) start, end - start, MADV_POPULATE_WRITE) < 0)
+#endif
+      {
+        for(uintptr_t p = start; p < end; p += page)
+          *(volatile char *) p = 0;
+      }
+    }
+    *tree_stamp(bp) |= 1; // prefaulted on purpose, keep purge_tree off it
+  }
+  checkheap(1);
+  arena_unlock(a);
+  return 0;
+}
+
+/*
+ * mm_stats - fill in stats with the counters of all arenas and of the
+ * mapped blocks, without walking any heap
+ */
+void mm_stats(struct mm_stats *stats) {
+  int n = arena_total();
+
+  memset(stats, 0, sizeof(*stats));
+  for(int i = 0; i < n; i++){
+    arena_lock(arena_at(i));
+    stats->live_bytes += arena->live_bytes;
+    stats->heap_bytes += (char *) heap_hi() + 1 - (char *) arena->heap_base;
+    stats->free_blocks += arena->seg_free_list_size;
+    stats->splits += arena->splits;
+    stats->coalesces += arena->coalesces;
+    stats->sbrk_calls += arena->sbrk_calls;
+    arena_unlock(arena_at(i));
+  }
+
+  stats->peak_heap_bytes = __atomic_load_n(&peak_heap_bytes, __ATOMIC_RELAXED);
+
+  pthread_mutex_lock(&mapped_lock);
+  stats->mapped_bytes = mapped_bytes;
+  stats->mapped_blocks = mapped_count;
+  pthread_mutex_unlock(&mapped_lock);
+}
+
+// mm_trim for the arena whose lock the caller holds
+static int heap_trim(size_t pad) {
+  uint32_t *epilogue = (uint32_t *) ((char *) heap_hi() + 1) - WSIZE;
+  uint32_t *hdr;
+  uint32_t size, keep;
+  size_t trim, step;
+
+  if(arena->trim_unsupported || !block_prev_free(epilogue))
+    return 0;
+  checkheap(1);
+
+  hdr = block_prev(epilogue);
+  size = block_size(hdr);
+  keep = 2 * ((pad + 7) / 8); // in words, keeps the heap end 8-byte aligned
+  if(keep != 0 && keep < MIN_BLOCK)
+    keep = MIN_BLOCK;
+#ifdef HUGE_PAGES
+  // end on a huge page boundary like extend_heap does
+  keep += (HUGE_PAGE_SIZE - (uintptr_t) (hdr + keep + 1) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE / 4;
+  if(keep != 0 && keep < MIN_BLOCK)
+    keep += HUGE_PAGE_SIZE / 4;
+#endif
+  if(keep >= size)
+    return 0;
+
+  removeBlock(block_mem(hdr)); // its links may lie above the new heap end
+  // mem_sbrk takes an int, so a free top of 2GB or more goes in steps
+  for(trim = (size_t) (size - keep) * 4; trim > 0; trim -= step){
+    step = trim < TRIM_STEP ? trim : TRIM_STEP;
+    if((long) arena_sbrk(-(int) step) < 0)
+      break;
+  }
+  if(trim == (size_t) (size - keep) * 4){ // nothing given back
+    arena->trim_unsupported = 1;
+    addFirst(block_mem(hdr));
+    return 0;
+  }
+  keep += trim / 4; // what a refused step left over
+
+  // the new epilogue right after the kept part, or in place of the header
+  // if nothing is kept; the block in front of it stays allocated
+  if(keep != 0){
+    block_set_size(hdr, keep);
+    hdr[keep] = 0;
+  }
+  block_set_size(hdr + keep, 0);
+  block_mark(hdr + keep, ALLOC);
+  if(keep != 0){
+    block_mark(hdr, FREE); // footer and the epilogue's prev bit
+    addFirst(block_mem(hdr));
+  }
+  arena->grow_words = CHUNKSIZE; // the heap shrinks, it does not ramp
+  checkheap(1);
+  return 1;
+}
+
+/*
+ * calloc - you may want to look at mm-naive.c
+ */
+void *calloc (size_t nmemb, size_t size) {
+  size_t bytes = nmemb * size;
+  void *newptr;
+
+  newptr = malloc(bytes);
+  if(newptr == NULL)
+    return NULL;
+  if(arena_of(newptr) != NULL) // fresh mappings are zero already
+    memset(newptr, 0, bytes);
+  return newptr;
+}
+
+// check the subtree at node: order by size within (lo, hi), heap order of
+// priorities, chain links; returns the number of free blocks or -1
+static int check_tree(uint32_t *node, uint32_t lo, uint32_t hi) {
+    if(node == NULL)
+      return 0;
+
+    if(node < arena->heap_base || node >= (uint32_t *) heap_hi()){
+      printf(" checkheap: tree pointer is not between mem_heap_lo and mem_heap_hi\n");
+      return -1;
+    }
+    if(link_prev(node) != NULL){
+      printf(" checkheap: tree node has a prev pointer\n");
+      return -1;
+    }
+    if(tree_size(node) < TREE_THRESHOLD){
+      printf(" checkheap: block smaller than TREE_THRESHOLD in tree\n");
+      return -1;
+    }
+    if(tree_size(node) <= lo || tree_size(node) >= hi){
+      printf(" checkheap: tree is not ordered by size\n");
+      return -1;
+    }
+
+    int count = 0;
+    uint32_t *prev = node;
+    uint32_t *iter = node;
+    while(iter != NULL){ // node and its chain
+      if(iter != node && link_prev(iter) != prev){
+        printf(" checkheap: chain block's prev does not point back to the previous block\n");
+        return -1;
+      }
+      if(!block_free(block_hdrp(iter))){
+        printf(" checkheap: allocated block in tree\n");
+        return -1;
+      }
+      if(tree_size(iter) != tree_size(node)){
+        printf(" checkheap: chain block size differs from its tree node\n");
+        return -1;
+      }
+      count++;
+      prev = iter;
+      iter = link_succ(iter);
+    }
+
+    uint32_t *left = from_offset(*tree_left(node));
+    uint32_t *right = from_offset(*tree_right(node));
+    if((left != NULL && *tree_priority(left) > *tree_priority(node)) ||
+       (right != NULL && *tree_priority(right) > *tree_priority(node))){
+      printf(" checkheap: tree is not heap ordered by priority\n");
+      return -1;
+    }
+
+    int left_count = check_tree(left, lo, tree_size(node));
+    int right_count = check_tree(right, tree_size(node), hi);
+    if(left_count < 0 || right_count < 0)
+      return -1;
+    return count + left_count + right_count;
+}
+
+// check the heap of the arena whose lock the caller holds
+static int check_arena(int verbose) {
+
+    if(verbose == 1){ // if verbose == 1, then check heap
+
+        // check prologue blocks
+        if(block_size(block_hdrp(arena->heap_listp)) != 2){
+          printf(" checkheap: prologue header size error\n");
+          return 1;
+        }
+        if(block_free(block_hdrp(arena->heap_listp)) != 0){
+          printf(" checkheap: prologue header free/alloc bit error\n");
+          return 1;
+        }
+
+        // check heap boundary(first block next to the list heads)
+        // check epilogue block
+        if(block_size(arena->seg_free_list_header + HEAD_WORDS) != 0){
+          printf(" checkheap: heap low boundary size error\n");
+          return 1;
+        }
+        if(block_free(arena->seg_free_list_header + HEAD_WORDS) != 1){
+          printf(" checkheap: heap low boundary free/alloc bit error\n");
+          return 1;
+        }
+        if(block_size((uint32_t *) ((char *)heap_hi() - 3)) != 0){
+          printf(" checkheap: epilogue size error\n");
+          return 1;
+        }
+        if(block_free((uint32_t *) ((char *)heap_hi() - 3)) != 0){
+          printf(" checkheap: epilogue free/alloc bit error\n");
+          return 1;
+        }
+
+        // check each block's address alignment
+        /* check each block's header and footer: minimum size, alignment,
+           bit consistency, header and footer matching of free blocks,
+           prev bit matching the previous block, no two consecutive free blocks */
+        uint32_t *ptr = arena->heap_listp;
+        uint32_t free_block_flag = 0;
+
+        int freeblock_num_iterate = 0; // free block count by iterating every block
+        size_t live_iterate = 0; // live bytes by iterating every block, quick bins included
+
+        while(1){
+            if(aligned(ptr) != 1){
+              printf(" checkheap: payload block alignment problem\n");
+              return 1;
+            }
+            if(block_prev_free(block_next(block_hdrp(ptr))) !=
+               block_free(block_hdrp(ptr))){
+              printf(" checkheap: prev bit in next header does not match this block\n");
+              return 1;
+            }
+            if(ptr == arena->heap_listp){
+              if(block_size(block_hdrp(ptr)) < 2){
+                printf(" checkheap: size in header of prologue less than 2-words-minimum\n");
+                return 1;
+              }
+            }else{
+              if(block_size(block_hdrp(ptr)) < MIN_BLOCK){
+                printf(" checkheap: size in header less than 4-words-minimum\n");
+                return 1;
+              }
+            }
+            if(block_free(block_hdrp(ptr))){ // only free blocks have a footer
+              if(aligned(block_ftrp(ptr)) != 1){
+                printf(" checkheap: footer block alignment problem\n");
+                return 1;
+              }
+              if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
+                printf(" checkheap: size in header not equal to size in footer\n");
+                return 1;
+              }
+              if(block_free(block_ftrp(ptr)) != 1){
+                printf(" checkheap: free/alloc bit in header not equal to free/alloc bit in footer\n");
+                return 1;
+              }
+            }
+
+            if(!block_free(block_hdrp(ptr)) && ptr != arena->heap_listp){
+              struct slab_run *run = slab_run_of(arena, ptr);
+              if(run != NULL)
+                live_iterate += (size_t) (run->nslots - run->free_slots) * run->slot_size;
+              else
+                live_iterate += (block_size(block_hdrp(ptr)) - 1) * 4;
+            }
+
+            // check no two consecutive free blocks
+            if(free_block_flag == 0 && block_free(block_hdrp(ptr)) == 1){
+              freeblock_num_iterate++; // add free block count
+              // first time free blocks
+              free_block_flag = 1;
+            }else if(free_block_flag == 1 && block_free(block_hdrp(ptr)) == 1){
+              printf(" checkheap: two consecutive free blocks error\n");
+              return 1;
+            }else{
+              free_block_flag = 0;
+            }
+
+            // check whether move to next block or terminate
+            // or face with a fatal error
+            if(block_size(block_next(block_hdrp(ptr))) == 0 &&
+              block_free(block_next(block_hdrp(ptr))) == 0){
+              if(block_next(block_hdrp(ptr)) == (uint32_t *)((char *)heap_hi() - 3)){
+                break; // exit while loop
+              }else{
+                printf(" checkheap: fatal error: this should be a new header, but its value shows that it is an epilogue\n");
+                return 1;
+              }
+            }else{
+              ptr = block_mem(block_next(block_hdrp(ptr))); // move to next block
+            }
+        }
+
+        // segregated free list check
+        if(arena->seg_free_list_size < 0){
+          printf(" checkheap: seg_free_list_size < 0\n");
+          return 1;
+        }
+
+        int freeblock_num_traverse = 0; // free block count by traversing through pointers
+
+        for(int class = 0; class < NUM_CLASSES; class++){
+          uint32_t *prev = NULL;
+          uint32_t *iter = from_offset(arena->seg_free_list_header[class]);
+
+          if(!(arena->seg_free_list_map >> class & 1) != (iter == NULL)){
+            printf(" checkheap: seg_free_list_map bit does not match list %d\n", class);
+            return 1;
+          }
+
+          while(iter != NULL){
+            if(iter < arena->heap_base || iter >= (uint32_t *) heap_hi()){
+              printf(" checkheap: free list pointer is not between mem_heap_lo and mem_heap_hi\n");
+              return 1;
+            }
+            if(link_prev(iter) != prev){
+              printf(" checkheap: iter's prev does not point back to the previous block\n");
+              return 1;
+            }
+            if(!block_free(block_hdrp(iter))){
+              printf(" checkheap: allocated block in free list\n");
+              return 1;
+            }
+            if(size_class(block_size(block_hdrp(iter))) != class){
+              printf(" checkheap: free block in wrong size class\n");
+              return 1;
+            }
+            freeblock_num_traverse++;
+            prev = iter;
+            iter = link_succ(iter); // move to the next free block
+          }
+        }
+
+        // slab runs with free slots
+        for(int class = 0; class < SLAB_CLASSES; class++){
+          uint32_t *prev = NULL;
+          uint32_t *iter = from_offset(arena->slab_run_header[class]);
+
+          while(iter != NULL){
+            struct slab_run *run = (struct slab_run *) iter;
+            int used = 0;
+
+            if(iter < arena->heap_base || iter >= (uint32_t *) heap_hi()){
+              printf(" checkheap: slab run pointer is not between mem_heap_lo and mem_heap_hi\n");
+              return 1;
+            }
+            if(slab_run_of(arena, iter) != run){
+              printf(" checkheap: slab run not aligned or not in the run map\n");
+              return 1;
+            }
+            if(link_prev(iter) != prev){
+              printf(" checkheap: slab run's prev does not point back to the previous run\n");
+              return 1;
+            }
+            if(block_free(block_hdrp(iter)) || block_size(block_hdrp(iter)) != RUN_WORDS){
+              printf(" checkheap: slab run is not an allocated block of RUN_WORDS\n");
+              return 1;
+            }
+            if(run->slot_size != 8 * (class + 1)){
+              printf(" checkheap: slab run in wrong class\n");
+              return 1;
+            }
+            for(int w = 0; w < (int) (sizeof(run->used) / 8); w++)
+              used += __builtin_popcountll(run->used[w]);
+            if(run->free_slots == 0 ||
+               run->free_slots != 64 * (int) (sizeof(run->used) / 8) - used){
+              printf(" checkheap: slab run free slot count does not match its bitmap\n");
+              return 1;
+            }
+            prev = iter;
+            iter = link_succ(iter);
+          }
+        }
+
+        // quick bins
+        for(int i = 0; i < QUICK_BINS; i++){
+          uint32_t count = 0;
+
+          if(!(arena->quick_map >> i & 1) != (arena->quick_bin_header[i] == END_OF_LIST)){
+            printf(" checkheap: quick_map bit does not match quick bin %d\n", i);
+            return 1;
+          }
+          for(uint32_t *iter = from_offset(arena->quick_bin_header[i]); iter != NULL;
+              iter = from_offset(iter[0])){
+            if(iter < arena->heap_base || iter >= (uint32_t *) heap_hi()){
+              printf(" checkheap: quick bin pointer is not between mem_heap_lo and mem_heap_hi\n");
+              return 1;
+            }
+            if(block_free(block_hdrp(iter))){
+              printf(" checkheap: free block in quick bin\n");
+              return 1;
+            }
+            if(block_size(block_hdrp(iter)) != 2 * (uint32_t) i){
+              printf(" checkheap: block in wrong quick bin\n");
+              return 1;
+            }
+            if(++count > QUICK_COUNT){
+              printf(" checkheap: quick bin holds more than QUICK_COUNT blocks\n");
+              return 1;
+            }
+            live_iterate -= (block_size(block_hdrp(iter)) - 1) * 4;
+          }
+          if(count != arena->quick_bin_count[i]){
+            printf(" checkheap: quick bin count does not match bin %d\n", i);
+            return 1;
+          }
+        }
+
+        int freeblock_num_tree = check_tree(from_offset(arena->seg_free_tree_root), 0, 0xFFFFFFFF);
+        if(freeblock_num_tree < 0)
+          return 1;
+        freeblock_num_traverse += freeblock_num_tree;
+
+        if(freeblock_num_traverse != arena->seg_free_list_size){
+          printf(" checkheap: seg_free_list_size does not match the lists\n");
+          return 1;
+        }
+        if(freeblock_num_traverse != freeblock_num_iterate){
+          printf(" checkheap: free blocks number not match\n");
+          return 1;
+        }
+        if(live_iterate != arena->live_bytes){
+          printf(" checkheap: live_bytes does not match the heap\n");
+          return 1;
+        }
+        if(__atomic_load_n(&peak_heap_bytes, __ATOMIC_RELAXED) <
+           (size_t) ((char *) heap_hi() + 1 - (char *) arena->heap_base)){
+          printf(" checkheap: peak_heap_bytes below the heap size of the arena\n");
+          return 1;
+        }
+
+    }
+    return 0;
+}
+
+// check the mapped block table, mapped_lock held
+static int check_mapped(void) {
+    size_t mapped_num = 0;
+
+    for(size_t i = 0; i < mapped_table_capacity; i++){
+      if(mapped_table[i] == NULL)
+        continue;
+      if(arena_of(mapped_table[i]) != NULL){
+        printf(" checkheap: mapped block inside an arena\n");
+        return 1;
+      }
+      if(mapped_table_find(mapped_table[i]) != (long) i){
+        printf(" checkheap: mapped block not reachable from its home slot\n");
+        return 1;
+      }
+      if(mapped_size(mapped_table[i]) + MMAP_HEADER !=
+         mapped_length(mapped_size(mapped_table[i]))){
+        printf(" checkheap: mapped block length is not a page multiple\n");
+        return 1;
+      }
+      mapped_num++;
+    }
+    if(mapped_num != mapped_count){
+      printf(" checkheap: mapped_count does not match the table\n");
+      return 1;
+    }
+    return 0;
+}
+
+// Returns 0 if no errors were found, otherwise returns the error;
+// checks the arena the caller has locked, or all of them
+int mm_checkheap(int verbose) {
+    int err = 0;
+
+    if(arena != NULL){ // from checkheap inside the allocator
+      err = check_arena(verbose);
+    }else{
+      int n = arena_total();
+
+      for(int i = 0; i < n && !err; i++){
+        arena_lock(arena_at(i));
+        err = check_arena(verbose);
+        arena_unlock(arena_at(i));
+      }
+    }
+    if(err || verbose != 1)
+      return err;
+
+    pthread_mutex_lock(&mapped_lock);
+    err = check_mapped();
+    pthread_mutex_unlock(&mapped_lock);
+    return err;
+}
@@ -0,0 +1,58 @@
+/*
+ * mm_ext.h - interfaces the segregated free list allocator offers on top
+ * of the ones in mm.h.
+ */
+
+#ifndef MM_EXT_H
+#define MM_EXT_H
+
+#include <stddef.h>
+
+/*
+ * Give the free memory at the top of the heap back to the system, keeping
+ * at least pad bytes of it. Returns 1 if the heap shrank, 0 otherwise.
+ */
+extern int mm_trim(size_t pad);
+
+/*
+ * Return how many times the heaps grew since mm_init, one mem_sbrk call or
+ * arena brk move each.
+ */
+extern size_t mm_sbrk_calls(void);
+
+/*
+ * Grow the heap of the calling thread's arena once so that its top is a
+ * single free block of at least bytes, and fault in its pages right away
+ * if prefault is set, so that the mallocs it serves take neither a
+ * mem_sbrk nor a page fault. free does not trim the heap back below the
+ * reservation. Returns 0 on success, -1 if the heap cannot grow that far:
+ * the main arena grows by less than 2GB per call, and a thread on any other
+ * arena cannot reserve more than what is left of its slot of ARENA_SIZE
+ * bytes (64MB by default).
+ */
+extern int mm_reserve(size_t bytes, int prefault);
+
+/*
+ * Counters of the allocator as a whole, summed over all arenas. Blocks
+ * sitting in the cache of a thread count as live, blocks in its own
+ * mapping count as mapped and not as heap.
+ */
+struct mm_stats {
+    size_t live_bytes; // usable bytes of the blocks handed out
+    size_t heap_bytes; // heap of all arenas
+    size_t peak_heap_bytes; // largest heap_bytes has been
+    size_t mapped_bytes; // length of the mappings of large blocks
+    size_t mapped_blocks; // large blocks in their own mapping
+    size_t free_blocks; // free blocks on the lists and in the trees
+    size_t splits; // blocks cut in two by malloc or realloc
+    size_t coalesces; // free neighbours merged
+    size_t sbrk_calls; // times a heap grew
+};
+
+/*
+ * Fill in stats with a snapshot of the counters. The cost does not depend
+ * on the size of the heap, only on the number of arenas.
+ */
+extern void mm_stats(struct mm_stats *stats);
+
+#endif
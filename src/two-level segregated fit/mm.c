@@ -0,0 +1,790 @@
+/*
+ *  Name: Yijie Ma
+ *  AndrewID: yijiem
+ *
+ *  Two-Level Segregated Fit (TLSF) allocator.
+ *
+ *  Blocks use the same boundary tags as the explicit free list variants
+ *  (4-byte header and footer, size counted in words). Free blocks are kept
+ *  in a FL_COUNT x SL_COUNT matrix of doubly linked lists: the first level
+ *  is the most significant bit of the block size, the second level splits
+ *  that power of two into SL_COUNT equal ranges. Blocks below SMALL_BLOCK
+ *  words all go to first level 0, one list per size.
+ *
+ *  One bit per non-empty first level (tlsf_fl_bitmap) and one bit per
+ *  non-empty list of each first level (tlsf_sl_bitmap) let find_fit locate
+ *  a list whose every block fits with two count-trailing-zeros, after
+ *  rounding the request up to the next second level range. Together with
+ *  boundary-tag coalescing, malloc and free never walk a list, so every
+ *  operation except the copy in realloc and the memset in calloc is O(1).
+ *
+ *  The list heads and second level bitmaps live at the very beginning of
+ *  the heap, in front of the prologue.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "contracts.h"
+
+#include "mm.h"
+#include "memlib.h"
+
+
+// Create aliases for driver tests
+// DO NOT CHANGE THE FOLLOWING!
+#ifdef DRIVER
+#define malloc mm_malloc
+#define free mm_free
+#define realloc mm_realloc
+#define calloc mm_calloc
+#endif
+
+/*
+ *  Logging Functions
+ *  -----------------
+ *  - dbg_printf acts like printf, but will not be run in a release build.
+ *  - checkheap acts like mm_checkheap, but prints the line it failed on and
+ *    exits if it fails.
+ */
+
+#ifndef NDEBUG
+#define dbg_printf(...) printf(__VA_ARGS__)
+#define checkheap(verbose) do {if (mm_checkheap(verbose)) {  \
+                             printf("Checkheap failed on line %d\n", __LINE__);\
+                             exit(-1);  \
+                        }}while(0)
+#else
+#define dbg_printf(...)
+#define checkheap(...)
+#endif
+
+
+/*
+ *  some useful macro
+ */
+#define WSIZE 1    // use 4-bytes word size as basic amount of size
+#define DSIZE 2
+#define CHUNKSIZE (1 << 9) // 512 words
+#define OVERHEAD 2 // normal overhead in word(so it is 2 words)
+#define MIN_BLOCK 6 // header + prev + succ + footer, in words
+
+#define FREE 1
+#define ALLOC 0
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+#define END_OF_LIST 0
+
+// two level index
+#define SL_SHIFT 4
+#define SL_COUNT (1 << SL_SHIFT) // 16 second level lists per first level
+#define FL_SHIFT (SL_SHIFT + 1)
+#define SMALL_BLOCK (1 << FL_SHIFT) // 32 words, smaller blocks use first level 0
+#define FL_COUNT (30 - FL_SHIFT + 1) // block_size has 30 bits
+
+// list heads(2 words each) and second level bitmaps(1 word each)
+#define LIST_AREA_WORDS (FL_COUNT * SL_COUNT * 2 + FL_COUNT)
+
+static uint64_t **tlsf_free_list_header; // FL_COUNT * SL_COUNT list heads
+static uint32_t *tlsf_sl_bitmap; // bit sl of [fl] set <=> list (fl, sl) not empty
+static uint32_t tlsf_fl_bitmap; // bit fl set <=> tlsf_sl_bitmap[fl] != 0
+static int tlsf_free_list_size;
+
+static uint32_t *heap_listp;
+static void *extend_heap(uint32_t words);
+static void *find_fit(uint32_t asize);
+static void place(void *bp, uint32_t asize);
+static void split_tail(void *bp, uint32_t asize);
+static void *coalesce(void *bp);
+static void addFirst(uint64_t **prev, uint64_t **succ);
+static void removeBlock(void *bp);
+
+/*
+ *  Helper functions
+ *  ----------------
+ */
+
+// Align p to a multiple of w bytes
+static inline void* align(const void const* p, unsigned char w) {
+    return (void*)(((uintptr_t)(p) + (w-1)) & ~(w-1));
+}
+
+// Check if the given pointer is 8-byte aligned
+static inline int aligned(const void const* p) {
+    return align(p, 8) == p;
+}
+
+// Return whether the pointer is in the heap.
+static inline int in_heap(const void* p) {
+    return p <= mem_heap_hi() && p >= mem_heap_lo();
+}
+
+
+/*
+ *  Block Functions
+ *  ---------------
+ *  TODO: Add your comment describing block functions here.
+ *  The functions below act similar to the macros in the book, but calculate
+ *  size in multiples of 4 bytes.
+ */
+
+// 参数全部改为指向head的指针 除了block_hdrp
+// Return the header pointer of the pointer points to payload
+
+// 参数：payload
+// 返回：header
+static inline uint32_t* block_hdrp(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block));
+
+    return block - 1;
+}
+
+// Return the size of the given block in multiples of the word size
+// 结果直接是 size based on word size, 不需要再除以WSIZE
+// 前2位: 0, a/f; 后30位: block size
+
+// 参数：header / footer
+// 返回：size
+static inline unsigned int block_size(const uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return (block[0] & 0x3FFFFFFF);
+}
+
+// Return the footer pointer of the pointer points to payload
+
+// 参数：payload
+// 返回：footer
+static inline uint32_t* block_ftrp(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block));
+
+    return block + block_size(block_hdrp(block)) - DSIZE;
+}
+
+// Return true if the block is free, false otherwise
+// 只有header或者footer可以作为此函数的参数
+
+// 参数：header / footer
+// 返回：free(1) / alloc(0)
+static inline int block_free(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return !(block[0] & 0x40000000);
+}
+
+// Mark the given block as free(1)/alloced(0) by marking the header and footer.
+
+// 参数：header(footer同时完成)
+// 返回：空
+static inline void block_mark(uint32_t* block, int free) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    if(block_size(block) == 0){
+      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
+      return;
+    } else {
+      unsigned int next = block_size(block) - 1;
+      block[0] = free ? block[0] & (int) 0xBFFFFFFF : block[0] | 0x40000000;
+      block[next] = block[0]; // 设置footer对应内容
+      return;
+    }
+}
+
+// set the block size to both header and footer
+
+// 参数：header(footer同时完成)
+// 返回：空
+static inline void block_set_size(uint32_t* block, uint32_t size_in_words) {
+  REQUIRES(block != NULL);
+  REQUIRES(in_heap(block));
+
+  if(size_in_words == 0) { // indicate the block do not have header or footer
+    block[0] = size_in_words;
+    return;
+  } else {
+    unsigned int next = size_in_words - 1;
+    block[0] = size_in_words;
+    block[next] = block[0]; // set footer
+    return;
+  }
+}
+
+// Return a pointer to the memory malloc should return
+
+// 参数：header
+// 返回：payload
+static inline  uint32_t* block_mem(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+    REQUIRES(aligned(block + 1));
+
+    return block + 1;
+}
+
+// Return the head pointer to the previous block
+
+// 参数：header
+// 返回：header
+static inline uint32_t* block_prev(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return block - block_size(block - WSIZE);
+}
+
+// Return the header to the next block
+
+// 参数：header
+// 返回：header
+static inline uint32_t* block_next(uint32_t* block) {
+    REQUIRES(block != NULL);
+    REQUIRES(in_heap(block));
+
+    return block + block_size(block);
+}
+
+
+/*
+ *  Two Level Index Functions
+ *  -------------------------
+ */
+
+// Return the list a free block of size words belongs to
+static inline void mapping_insert(uint32_t size, int *fl, int *sl) {
+    REQUIRES(size >= DSIZE);
+
+    if(size < SMALL_BLOCK){
+      *fl = 0;
+      *sl = size / (SMALL_BLOCK / SL_COUNT);
+    } else {
+      int msb = 31 - __builtin_clz(size);
+      *fl = msb - FL_SHIFT + 1;
+      *sl = (size >> (msb - SL_SHIFT)) ^ SL_COUNT; // drop the leading 1
+    }
+}
+
+// Return the first list whose every block is at least size words,
+// fl may come back as FL_COUNT when no list can hold the request
+static inline void mapping_search(uint32_t size, int *fl, int *sl) {
+    REQUIRES(size >= DSIZE);
+
+    if(size >= SMALL_BLOCK) // round up to the next second level range
+      size += (1 << (31 - __builtin_clz(size) - SL_SHIFT)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+// Return the head of list (fl, sl)
+static inline uint64_t **list_header(int fl, int sl) {
+    REQUIRES(fl >= 0 && fl < FL_COUNT);
+    REQUIRES(sl >= 0 && sl < SL_COUNT);
+
+    return &tlsf_free_list_header[fl * SL_COUNT + sl];
+}
+
+
+/*
+ *  Malloc Implementation
+ *  ---------------------
+ *  The following functions deal with the user-facing malloc implementation.
+ */
+
+/*
+ * Initialize: return -1 on error, 0 on success.
+ */
+int mm_init(void) {
+
+  // init the list area + 4 words for prologue/epilogue
+  if((long)(heap_listp = mem_sbrk((LIST_AREA_WORDS + 4) * WSIZE * 4)) < 0)
+    return -1;
+
+  tlsf_free_list_header = (uint64_t **) heap_listp;
+  for(int i = 0; i < FL_COUNT * SL_COUNT; i++)
+    tlsf_free_list_header[i] = END_OF_LIST;
+  tlsf_sl_bitmap = heap_listp + FL_COUNT * SL_COUNT * 2;
+  for(int i = 0; i < FL_COUNT; i++)
+    tlsf_sl_bitmap[i] = 0;
+  tlsf_fl_bitmap = 0;
+  tlsf_free_list_size = 0;
+
+  heap_listp = heap_listp + LIST_AREA_WORDS; // move heap_listp to the first block
+
+  block_set_size(heap_listp, 0); // set first block for place holder
+  block_mark(heap_listp, FREE);
+
+  block_set_size(heap_listp + WSIZE, OVERHEAD); // set prologue block for 1st alloc block
+  block_mark(heap_listp + WSIZE, ALLOC);
+
+  block_set_size(heap_listp + WSIZE + DSIZE, 0); // set epilogue block
+  block_mark(heap_listp + WSIZE + DSIZE, ALLOC);
+
+  heap_listp += DSIZE;
+
+  if(extend_heap(CHUNKSIZE) == NULL)
+    return -1;
+
+  checkheap(1);
+  return 0;
+}
+
+static void *extend_heap(uint32_t words){
+
+  uint32_t *bp;
+  uint32_t size;
+
+  size = (words % 2) ? ((words + 1) * 4) : (words * 4); // convert to bytes
+  if((long)(bp = mem_sbrk(size)) < 0)  // use long for 64-bits machine!
+    return NULL;
+
+  block_set_size(block_hdrp(bp), size / 4); // bp is not the header, but the payload pointer
+  block_mark(block_hdrp(bp), FREE);
+
+  block_set_size(block_next(block_hdrp(bp)), 0); // set epilogue
+  block_mark(block_next(block_hdrp(bp)), ALLOC);
+
+  return coalesce(bp); // coalesce puts the new block on its list
+}
+
+// add free block indicated by prev and succ to the first element of its
+// list, the block size must already be set
+static void addFirst(uint64_t **prev, uint64_t **succ){
+  int fl, sl;
+  mapping_insert(block_size(block_hdrp((uint32_t *) prev)), &fl, &sl);
+  uint64_t **header = list_header(fl, sl);
+
+  *prev = END_OF_LIST;
+  *succ = *header;
+  if(*header != END_OF_LIST)
+    *(uint64_t **) *header = (uint64_t *) prev; // old first block points back to bp
+  *header = (uint64_t *) prev;
+
+  tlsf_sl_bitmap[fl] |= 1U << sl;
+  tlsf_fl_bitmap |= 1U << fl;
+  tlsf_free_list_size++;
+}
+
+// take free block bp off its list, must be called before its size changes
+static void removeBlock(void *bp){
+  uint64_t *prev = *(uint64_t **) bp;
+  uint64_t *succ = *((uint64_t **) bp + 1);
+
+  if(prev == END_OF_LIST){ // bp is the first block of its list
+    int fl, sl;
+    mapping_insert(block_size(block_hdrp(bp)), &fl, &sl);
+    *list_header(fl, sl) = succ;
+    if(succ == END_OF_LIST){ // and the last one
+      tlsf_sl_bitmap[fl] &= ~(1U << sl);
+      if(tlsf_sl_bitmap[fl] == 0)
+        tlsf_fl_bitmap &= ~(1U << fl);
+    }
+  }else{
+    *((uint64_t **) prev + 1) = succ; // prev block's succ pointer
+  }
+
+  if(succ != END_OF_LIST)
+    *(uint64_t **) succ = prev;
+
+  tlsf_free_list_size--;
+}
+
+// Return the block size in words for a request of size bytes,
+// the minimum block is 24 bytes, same as the explicit free list
+static inline size_t adjust_size(size_t size){
+  size_t asize;
+
+  if(size <= 16) // set actual size
+    asize = 16 + 8;
+  else
+    asize = 8 * ((size + 8 + (8 - 1)) / 8);
+
+  return asize / 4; // convert bytes to words
+}
+
+/*
+ * malloc
+ */
+void *malloc (size_t size) {
+  checkheap(1);  // Let's make sure the heap is ok!
+  size_t asize;  // actual size
+  size_t extendsize;
+  uint32_t *bp;
+
+  if(size <= 0)
+    return NULL;
+
+  asize = adjust_size(size);
+
+  if((bp = find_fit(asize)) != NULL){ // find fit place
+    place(bp, asize);
+    checkheap(1);
+    return bp;
+  }
+
+  extendsize = MAX(asize, CHUNKSIZE); // do not find fit place
+  if((bp = extend_heap(extendsize / WSIZE)) == NULL)
+    return NULL;
+  place(bp, asize);
+  checkheap(1);
+  return bp;
+}
+
+// good fit in constant time: the first block of the lowest non-empty list
+// at or above the rounded request, no list is ever walked
+static void *find_fit(uint32_t asize){
+  int fl, sl;
+  uint32_t sl_map;
+
+  mapping_search(asize, &fl, &sl);
+  if(fl >= FL_COUNT)
+    return NULL;
+
+  sl_map = tlsf_sl_bitmap[fl] & (~0U << sl);
+  if(sl_map == 0){ // nothing left on this first level, go up
+    uint32_t fl_map = tlsf_fl_bitmap & (~0U << (fl + 1));
+    if(fl_map == 0)
+      return NULL;
+    fl = __builtin_ctz(fl_map);
+    sl_map = tlsf_sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+
+  return *list_header(fl, sl);
+}
+
+static void place(void *bp, uint32_t asize){
+  uint32_t csize = block_size(block_hdrp(bp));
+
+  removeBlock(bp);
+
+  // splitting condition is the minimum block size(6 words)
+  if((csize - asize) >= MIN_BLOCK){ // split the block
+    block_set_size(block_hdrp(bp), asize);
+    block_mark(block_hdrp(bp), ALLOC);
+
+    bp = block_mem(block_next(block_hdrp(bp))); // bp points to next split block's payload
+
+    block_set_size(block_hdrp(bp), csize - asize);
+    block_mark(block_hdrp(bp), FREE);
+
+    addFirst((uint64_t **) bp, (uint64_t **) bp + 1);
+  }
+
+  else{ // do not split the block
+    block_mark(block_hdrp(bp), ALLOC);
+  }
+}
+
+// cut allocated block bp down to asize words and free the tail, as long as
+// the tail is big enough to be a block of its own
+static void split_tail(void *bp, uint32_t asize){
+  uint32_t csize = block_size(block_hdrp(bp));
+
+  if((csize - asize) < MIN_BLOCK) // do not split the block
+    return;
+
+  block_set_size(block_hdrp(bp), asize);
+  block_mark(block_hdrp(bp), ALLOC);
+
+  bp = block_mem(block_next(block_hdrp(bp))); // bp points to the tail's payload
+
+  block_set_size(block_hdrp(bp), csize - asize);
+  block_mark(block_hdrp(bp), FREE);
+
+  coalesce(bp); // the tail may touch a free next block
+}
+
+
+/*
+ * free
+ */
+void free(void *bp) {
+
+  if((long)bp <= 0)
+    return;
+  checkheap(1);
+  block_mark(block_hdrp(bp), FREE);
+
+  coalesce(bp);
+  checkheap(1);
+}
+
+// merge bp with its free neighbours and put the result on its list,
+// bp itself must not be on any list yet
+static void *coalesce(void *bp){
+  uint32_t *hdr = block_hdrp(bp);
+  uint32_t size = block_size(hdr);
+
+  if(block_free(block_next(hdr))){ // merge next
+    removeBlock(block_mem(block_next(hdr)));
+    size += block_size(block_next(hdr));
+  }
+
+  if(block_free(block_prev(hdr))){ // merge prev
+    hdr = block_prev(hdr);
+    removeBlock(block_mem(hdr));
+    size += block_size(hdr);
+  }
+
+  block_set_size(hdr, size);
+  block_mark(hdr, FREE);
+
+  bp = block_mem(hdr);
+  addFirst((uint64_t **) bp, (uint64_t **) bp + 1);
+  return bp;
+}
+
+
+/*
+ * realloc - you may want to look at mm-naive.c
+ */
+void *realloc(void *oldptr, size_t size) {
+  size_t oldsize;
+  size_t asize;
+  size_t avail;
+  void *newptr;
+  checkheap(1);
+  if(size == 0){
+    free(oldptr);
+    return NULL; // should return NULL
+  }
+
+  if(oldptr == NULL){
+    return malloc(size);
+  }
+
+  asize = adjust_size(size);
+
+  uint32_t *hdr = block_hdrp(oldptr);
+  uint32_t *next = block_next(hdr);
+  avail = block_size(hdr); // what oldptr can get without moving
+
+  if(block_free(next))
+    avail += block_size(next);
+
+  if(asize > avail &&
+    block_size(block_free(next) ? block_next(next) : next) == 0){
+    // oldptr is the last block, maybe followed by one free block: grow the
+    // heap, extend_heap merges the new space into a free block after oldptr
+    if(extend_heap(MAX(asize - avail, CHUNKSIZE)) == NULL)
+      return NULL;
+    next = block_next(hdr);
+    avail = block_size(hdr) + block_size(next);
+  }
+
+  if(asize <= avail){
+    if(avail > block_size(hdr)){ // take over the free next block
+      removeBlock(block_mem(next));
+      block_set_size(hdr, avail);
+      block_mark(hdr, ALLOC);
+    }
+    split_tail(oldptr, asize); // shrink in place, or give back what is left over
+    checkheap(1);
+    return oldptr;
+  }
+
+  newptr = malloc(size);
+
+  if(!newptr){
+    return 0;
+  }
+
+  oldsize = block_size(block_hdrp(oldptr));
+  oldsize *= 4;
+  if(size < oldsize) // convert words to bytes
+    oldsize = size;
+  memcpy(newptr, oldptr, oldsize);
+
+  free(oldptr);
+  checkheap(1);
+  return newptr;
+}
+
+/*
+ * calloc - you may want to look at mm-naive.c
+ */
+void *calloc (size_t nmemb, size_t size) {
+  size_t bytes = nmemb * size;
+  void *newptr;
+  checkheap(1);
+
+  newptr = malloc(bytes);
+  if(newptr == NULL)
+    return NULL;
+  memset(newptr, 0, bytes);
+  checkheap(1);
+  return newptr;
+}
+
+// Returns 0 if no errors were found, otherwise returns the error
+int mm_checkheap(int verbose) {
+
+    if(verbose == 1){ // if verbose == 1, then check heap
+
+        // check prologue blocks
+        if(block_size(block_hdrp(heap_listp)) != 2){
+          printf(" checkheap: prologue header size error\n");
+          return 1;
+        }
+        if(block_free(block_hdrp(heap_listp)) != 0){
+          printf(" checkheap: prologue header free/alloc bit error\n");
+          return 1;
+        }
+        if(block_size(heap_listp) != 2){
+          printf(" checkheap: prologue footer size error\n");
+          return 1;
+        }
+        if(block_free(heap_listp) != 0){
+          printf(" checkheap: prologue footer free/alloc bit error\n");
+          return 1;
+        }
+
+        // check heap boundary(first block next to the list area)
+        // check epilogue block
+        if(block_size((uint32_t *)mem_heap_lo() + LIST_AREA_WORDS) != 0){
+          printf(" checkheap: heap low boundary size error\n");
+          return 1;
+        }
+        if(block_free((uint32_t *)mem_heap_lo() + LIST_AREA_WORDS) != 1){
+          printf(" checkheap: heap low boundary free/alloc bit error\n");
+          return 1;
+        }
+        if(block_size((uint32_t *) ((char *)mem_heap_hi() - 3)) != 0){
+          printf(" checkheap: epilogue size error\n");
+          return 1;
+        }
+        if(block_free((uint32_t *) ((char *)mem_heap_hi() - 3)) != 0){
+          printf(" checkheap: epilogue free/alloc bit error\n");
+          return 1;
+        }
+
+        // check each block's address alignment
+        /* check each block's header and footer: minimum size, alignment,
+           bit consistency, header and footer matching,
+           no two consecutive free blocks */
+        uint32_t *ptr = heap_listp;
+        uint32_t free_block_flag = 0;
+
+        int freeblock_num_iterate = 0; // free block count by iterating every block
+
+        while(1){
+            if(aligned(ptr) != 1){
+              printf(" checkheap: payload block alignment problem\n");
+              return 1;
+            }
+            if(aligned(block_ftrp(ptr)) != 1){
+              printf(" checkheap: footer block alignment problem\n");
+              return 1;
+            }
+            if(ptr == heap_listp){
+              if(block_size(block_hdrp(ptr)) < 2){
+                printf(" checkheap: size in header of prologue less than 2-words-minimum\n");
+                return 1;
+              }
+            }else{
+              if(block_size(block_hdrp(ptr)) < MIN_BLOCK){
+                printf(" checkheap: size in header less than 6-words-minimum\n");
+                return 1;
+              }
+            }
+            if(block_size(block_hdrp(ptr)) != block_size(block_ftrp(ptr))){
+              printf(" checkheap: size in header not equal to size in footer\n");
+              return 1;
+            }
+            if(block_free(block_hdrp(ptr)) != block_free(block_ftrp(ptr))){
+              printf(" checkheap: free/alloc bit in header not equal to free/alloc bit in footer\n");
+              return 1;
+            }
+
+            // check no two consecutive free blocks
+            if(free_block_flag == 0 && block_free(block_hdrp(ptr)) == 1){
+              freeblock_num_iterate++; // add free block count
+              // first time free blocks
+              free_block_flag = 1;
+            }else if(free_block_flag == 1 && block_free(block_hdrp(ptr)) == 1){
+              printf(" checkheap: two consecutive free blocks error\n");
+              return 1;
+            }else{
+              free_block_flag = 0;
+            }
+
+            // check whether move to next block or terminate
+            // or face with a fatal error
+            if(block_size(block_next(block_hdrp(ptr))) == 0 &&
+              block_free(block_next(block_hdrp(ptr))) == 0){
+              if(block_next(block_hdrp(ptr)) == (uint32_t *)((char *)mem_heap_hi() - 3)){
+                break; // exit while loop
+              }else{
+                printf(" checkheap: fatal error: this should be a new header, but its value shows that it is an epilogue\n");
+                return 1;
+              }
+            }else{
+              ptr = block_mem(block_next(block_hdrp(ptr))); // move to next block
+            }
+        }
+
+        // two level list check
+        int freeblock_num_traverse = 0; // free block count by traversing through pointers
+
+        for(int fl = 0; fl < FL_COUNT; fl++){
+          if(!(tlsf_fl_bitmap >> fl & 1) != (tlsf_sl_bitmap[fl] == 0)){
+            printf(" checkheap: tlsf_fl_bitmap bit does not match first level %d\n", fl);
+            return 1;
+          }
+          for(int sl = 0; sl < SL_COUNT; sl++){
+            uint64_t *prev = END_OF_LIST;
+            uint64_t **iter = (uint64_t **) *list_header(fl, sl);
+
+            if(!(tlsf_sl_bitmap[fl] >> sl & 1) != (iter == END_OF_LIST)){
+              printf(" checkheap: tlsf_sl_bitmap bit does not match list (%d, %d)\n", fl, sl);
+              return 1;
+            }
+
+            while(iter != END_OF_LIST){
+              int block_fl, block_sl;
+
+              if(iter < (uint64_t **) mem_heap_lo() ||
+                 iter >= (uint64_t **) mem_heap_hi()){
+                printf(" checkheap: free list pointer is not between mem_heap_lo and mem_heap_hi\n");
+                return 1;
+              }
+              if(*iter != prev){
+                printf(" checkheap: iter's prev does not point back to the previous block\n");
+                return 1;
+              }
+              if(!block_free(block_hdrp((uint32_t *) iter))){
+                printf(" checkheap: allocated block in free list\n");
+                return 1;
+              }
+              mapping_insert(block_size(block_hdrp((uint32_t *) iter)), &block_fl, &block_sl);
+              if(block_fl != fl || block_sl != sl){
+                printf(" checkheap: free block in wrong list\n");
+                return 1;
+              }
+              freeblock_num_traverse++;
+              prev = (uint64_t *) iter;
+              iter = (uint64_t **) *(iter + 1); // move to the next free block
+            }
+          }
+        }
+
+        if(freeblock_num_traverse != tlsf_free_list_size){
+          printf(" checkheap: tlsf_free_list_size does not match the lists\n");
+          return 1;
+        }
+        if(freeblock_num_traverse != freeblock_num_iterate){
+          printf(" checkheap: free blocks number not match\n");
+          return 1;
+        }
+
+    }
+    return 0;
+}